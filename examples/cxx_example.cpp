@@ -0,0 +1,85 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <mpi.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+#include "phdeem.hpp"
+
+int main( int argc, char** argv )
+{
+    // Initializing MPI
+    MPI_Init( &argc, &argv );
+
+    try
+    {
+        hdeem_bmc_data_t hdeem_data;
+        hdeem_data.hasGPIO = 1;
+        hdeem_data.host = "";
+        hdeem_data.user = "";
+        hdeem_data.password = "";
+
+        // The session is closed when it goes out of scope
+        phdeem::session session( hdeem_data, MPI_COMM_WORLD );
+        session.start( );
+
+        sleep( 1 );
+
+        // Work directly on the buffers libhdeem returned, without copying the values
+        phdeem::global_readings readings = session.get_global( );
+        auto blade = readings.blade_sensors( );
+        for( std::size_t i = 0; i < blade.size( ); ++i )
+        {
+            auto sensor = blade[i];
+            if( sensor.empty( ) )
+            {
+                continue;
+            }
+
+            double sum = std::accumulate( sensor.begin( ), sensor.end( ), 0.0 );
+            auto max = std::max_element( sensor.begin( ), sensor.end( ) );
+            std::cout << sensor.name( ) << ": " << sensor.size( ) << " values, mean "
+                      << sum / sensor.size( ) << ", max " << *max << std::endl;
+        }
+
+        session.stop( );
+    }
+    catch( const phdeem::error& e )
+    {
+        std::cerr << e.what( ) << " (" << e.status( ).mpi_ret_value << ", "
+                  << e.status( ).hdeem_ret_value << ")" << std::endl;
+    }
+
+    MPI_Finalize( );
+
+    return 0;
+}
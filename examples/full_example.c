@@ -83,6 +83,14 @@ int main( int argc, char** argv )
             sleep(1);
         }
 
+        // Dump the readings for an offline analysis with phdeem-analyze
+        char trace_path[MPI_MAX_PROCESSOR_NAME + 16];
+        snprintf( trace_path, sizeof( trace_path ), "%s.phdeem", processor_name );
+        ret = phdeem_write_trace( trace_path, &hdeem_data, &readings, NULL, 0, &caller,
+                                  &int_rets );
+        printf( "'Write trace'  from processor %s, global rank %d. Return value was %d\n",
+                processor_name, world_rank, ret );
+
         phdeem_data_free( &readings, &caller, &int_rets );
         printf( "'Free data'    from processor %s, global rank %d. Return value was %d\n",
                 processor_name, world_rank, ret );
@@ -28,10 +28,32 @@
 
 #include <hdeem.h>
 #include "phdeem.h"
+#include <limits.h>
 #include <mpi.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 
+/** The sampling rate of the blade sensors in samples per second */
+static const unsigned int _phdeem_blade_sampling_rate = 1000;
+
+/** The BMC connection shared by all phdeem sessions of this process */
+static hdeem_bmc_data_t _phdeem_bmc;
+/** Whether _phdeem_bmc holds an open connection */
+static int _phdeem_connected = 0;
+/** The number of open sessions using _phdeem_bmc */
+static int _phdeem_sessions = 0;
+/** Whether phdeem_disconnect() was called while sessions were still using the connection */
+static int _phdeem_disconnect_pending = 0;
+/** Copies of the parameters _phdeem_bmc was set up with, the caller's strings might be gone */
+static char* _phdeem_host = NULL;
+static char* _phdeem_user = NULL;
+static char* _phdeem_password = NULL;
+/** Whether the connection is kept open after phdeem_close(), -1 if not yet determined */
+static int _phdeem_persistent = -1;
+
 /**
  * Gives an unsigned int hash for a given string.
  *
@@ -54,6 +76,172 @@ static unsigned int _phdeem_hash( const char* str )
     return hash;
 }
 
+/**
+ * Returns whether the BMC connection should outlive phdeem_close().
+ *
+ * This is the case unless PHDEEM_PERSISTENT_CONNECTION is set to 0.
+ */
+static int _phdeem_is_persistent( void )
+{
+    if( _phdeem_persistent < 0 )
+    {
+        const char* env = getenv( "PHDEEM_PERSISTENT_CONNECTION" );
+        _phdeem_persistent = !( env != NULL && strcmp( env, "0" ) == 0 );
+    }
+
+    return _phdeem_persistent;
+}
+
+/**
+ * Compares two strings, either of which may be NULL.
+ */
+static int _phdeem_equal( const char* a, const char* b )
+{
+    if( a == NULL || b == NULL )
+    {
+        return a == b;
+    }
+
+    return strcmp( a, b ) == 0;
+}
+
+/**
+ * Duplicates a string, which may be NULL. Returns whether this succeeded.
+ */
+static int _phdeem_copy( char** copy, const char* str )
+{
+    *copy = str != NULL ? strdup( str ) : NULL;
+    return str == NULL || *copy != NULL;
+}
+
+/**
+ * Forgets the parameters of the shared connection.
+ */
+static void _phdeem_forget_parameters( void )
+{
+    free( _phdeem_host );
+    free( _phdeem_user );
+    free( _phdeem_password );
+    _phdeem_host = _phdeem_user = _phdeem_password = NULL;
+}
+
+/**
+ * Points the shared connection data to our copies of the parameters.
+ */
+static void _phdeem_own_parameters( void )
+{
+    _phdeem_bmc.host = _phdeem_host;
+    _phdeem_bmc.user = _phdeem_user;
+    _phdeem_bmc.password = _phdeem_password;
+}
+
+/**
+ * Closes the shared connection.
+ */
+static void _phdeem_release( void )
+{
+    hdeem_close( &_phdeem_bmc );
+    _phdeem_forget_parameters( );
+    _phdeem_connected = 0;
+    _phdeem_disconnect_pending = 0;
+}
+
+/**
+ * Closes a persistent connection which is still open at process exit.
+ */
+static void _phdeem_atexit( void )
+{
+    // Sessions never closed don't need the connection anymore either
+    if( _phdeem_connected )
+    {
+        _phdeem_release( );
+    }
+}
+
+/**
+ * Sets up the BMC connection, or hands out the already established one.
+ *
+ * Setting up the connection via hdeem_init() takes seconds, so it's done only once per process and
+ * reused by later sessions with the same parameters as long as the connection is persistent. An
+ * unused connection with other parameters is replaced, one still in use is an error.
+ *
+ * @param hdeem_data    Information that otherwise would have been passed to hdeem_init().
+ * @param info          phdeem_info_t holding the caller's information.
+ * @param ret_val       The phdeem_status_t the return values are stored in.
+ *
+ * @return              A phdeem return value.
+ */
+static int _phdeem_connect( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info,
+                            phdeem_status_t* ret_val )
+{
+    static int atexit_registered = 0;
+
+    if( _phdeem_connected )
+    {
+        int same = hdeem_data->hasGPIO == _phdeem_bmc.hasGPIO &&
+                   _phdeem_equal( hdeem_data->host, _phdeem_host ) &&
+                   _phdeem_equal( hdeem_data->user, _phdeem_user ) &&
+                   _phdeem_equal( hdeem_data->password, _phdeem_password );
+
+        // Warm path, the connection is still open from an earlier session
+        if( same )
+        {
+            // Hand out the connection, but leave the caller's strings in place
+            hdeem_bmc_data_t caller = *hdeem_data;
+            *hdeem_data = _phdeem_bmc;
+            hdeem_data->host = caller.host;
+            hdeem_data->user = caller.user;
+            hdeem_data->password = caller.password;
+
+            _phdeem_sessions++;
+            info->shared_connection = 1;
+            return PHDEEM_SUCCESS;
+        }
+
+        if( _phdeem_sessions > 0 )
+        {
+            return PHDEEM_CONNECTION_ERROR;
+        }
+
+        _phdeem_release( );
+    }
+
+    ret_val->hdeem_ret_value = hdeem_init( hdeem_data );
+    if( ret_val->hdeem_ret_value != 0 )
+    {
+        return PHDEEM_HDEEM_ERROR;
+    }
+
+    if( !_phdeem_is_persistent( ) )
+    {
+        return PHDEEM_SUCCESS;
+    }
+
+    // Without the parameters we can't tell whether later sessions may share the connection
+    if( !_phdeem_copy( &_phdeem_host, hdeem_data->host ) ||
+        !_phdeem_copy( &_phdeem_user, hdeem_data->user ) ||
+        !_phdeem_copy( &_phdeem_password, hdeem_data->password ) )
+    {
+        _phdeem_forget_parameters( );
+        return PHDEEM_SUCCESS;
+    }
+
+    _phdeem_bmc = *hdeem_data;
+    _phdeem_own_parameters( );
+    _phdeem_connected = 1;
+    _phdeem_sessions = 1;
+    info->shared_connection = 1;
+
+    // Nobody might call phdeem_disconnect(), so make sure the connection gets closed anyway
+    if( !atexit_registered )
+    {
+        atexit( _phdeem_atexit );
+        atexit_registered = 1;
+    }
+
+    return PHDEEM_SUCCESS;
+}
+
 int phdeem_init( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, MPI_Comm current_comm,
                  phdeem_status_t* ret_val )
 {
@@ -64,6 +252,8 @@ int phdeem_init( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, MPI_Comm cur
     int resultlen;
     char hostname[MPI_MAX_PROCESSOR_NAME];
 
+    info->shared_connection = 0;
+
     // Get, hash and store the hostname
     ret_val->mpi_ret_value = MPI_Get_processor_name( hostname, &resultlen );
     if( ret_val->mpi_ret_value != MPI_SUCCESS )
@@ -94,23 +284,35 @@ int phdeem_init( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, MPI_Comm cur
         return PHDEEM_MPI_ERROR;
     }
 
+    // A connection this process kept from an earlier session would block the new root of the node,
+    // so release it if no other session uses it, before the root connects
+    if( info->node_rank != 0 && _phdeem_connected && _phdeem_sessions == 0 )
+    {
+        _phdeem_release( );
+    }
+
+    ret_val->mpi_ret_value = MPI_Barrier( info->sub_comm );
+    if( ret_val->mpi_ret_value != MPI_SUCCESS )
+    {
+        return PHDEEM_MPI_ERROR;
+    }
+
     // If the split leads to the position where the caller is not root, exit.
     if( info->node_rank != 0 )
     {
         return PHDEEM_NOT_ROOT;
     }
 
-    // Else, initialize the HDEEM library
-    ret_val->hdeem_ret_value = hdeem_init( hdeem_data );
-
-    // Errors?
-    if( ret_val->hdeem_ret_value != 0 )
+    // Else, connect to the BMC or reuse the existing connection
+    int ret = _phdeem_connect( hdeem_data, info, ret_val );
+    if( ret == PHDEEM_CONNECTION_ERROR )
     {
-        return PHDEEM_HDEEM_ERROR;
+        // There's no session to close, so leave nothing behind for phdeem_close()
+        ret_val->mpi_ret_value = MPI_Comm_free( &info->sub_comm );
+        info->node_rank = -1;
     }
 
-    // Else return success
-    return PHDEEM_SUCCESS;
+    return ret;
 }
 
 int phdeem_close( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, phdeem_status_t* ret_val )
@@ -125,8 +327,24 @@ int phdeem_close( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, phdeem_stat
         return PHDEEM_NOT_ROOT;
     }
 
-    // Else, call hdeem_close() and return
-    hdeem_close( hdeem_data );
+    // Else, keep the shared connection for the next session or call hdeem_close()
+    if( info->shared_connection )
+    {
+        // hdeem might have updated the data during this session
+        _phdeem_bmc = *hdeem_data;
+        _phdeem_own_parameters( );
+
+        info->shared_connection = 0;
+        _phdeem_sessions--;
+        if( _phdeem_sessions == 0 && _phdeem_disconnect_pending )
+        {
+            _phdeem_release( );
+        }
+    }
+    else
+    {
+        hdeem_close( hdeem_data );
+    }
 
     // Free the node local communicator
     ret_val->mpi_ret_value = MPI_Comm_free( &info->sub_comm );
@@ -140,6 +358,29 @@ int phdeem_close( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, phdeem_stat
     return PHDEEM_SUCCESS;
 }
 
+int phdeem_disconnect( phdeem_status_t* ret_val )
+{
+    // Reset the return values
+    ret_val->hdeem_ret_value = 0;
+    ret_val->mpi_ret_value = MPI_SUCCESS;
+
+    // If there's no open connection in this process, we're not root anywhere
+    if( !_phdeem_connected )
+    {
+        return PHDEEM_NOT_ROOT;
+    }
+
+    // Sessions still using the connection close it when the last one ends
+    if( _phdeem_sessions > 0 )
+    {
+        _phdeem_disconnect_pending = 1;
+        return PHDEEM_SUCCESS;
+    }
+
+    _phdeem_release( );
+    return PHDEEM_SUCCESS;
+}
+
 int phdeem_start( hdeem_bmc_data_t* hdeem_data, const phdeem_info_t* info,
                   phdeem_status_t* ret_val )
 {
@@ -232,6 +473,541 @@ int phdeem_get_global( hdeem_bmc_data_t* hdeem_data, hdeem_global_reading_t* hde
     return PHDEEM_SUCCESS;
 }
 
+/** Message tags used by phdeem_gather_global() on its own communicator */
+enum phdeem_gather_tags
+{
+    PHDEEM_GATHER_TAG_LAYOUT    = 1,
+    PHDEEM_GATHER_TAG_CREDIT,
+    PHDEEM_GATHER_TAG_CHUNK
+};
+
+/**
+ * Describes the readings a node root streams to the collector.
+ *
+ * Sent as four MPI_UNSIGNED_LONG, so don't add any other members.
+ */
+typedef struct _phdeem_layout
+{
+    /** The number of samples, blade first, then VR */
+    unsigned long nb_values[2];
+    /** The number of sensors per sample, blade first, then VR */
+    unsigned long nb_sensors[2];
+} _phdeem_layout_t;
+
+/**
+ * The state of a node root the collector currently receives from.
+ */
+typedef struct _phdeem_slot
+{
+    /** Whether the layout has arrived and the chunks are being received */
+    int streaming;
+    /** The rank of the node root */
+    int source;
+    _phdeem_layout_t layout;
+    unsigned long nb_chunks;
+    /** The number of chunks requested and delivered to the callback so far */
+    unsigned long requested;
+    unsigned long delivered;
+    /** The chunks currently received into the buffers */
+    phdeem_chunk_t chunks[2];
+    float* buffers[2];
+} _phdeem_slot_t;
+
+/**
+ * Returns the number of chunks of the given kind.
+ */
+static unsigned long _phdeem_nb_chunks( const _phdeem_layout_t* layout, int is_vr,
+                                        unsigned long chunk_values )
+{
+    // Samples without any sensors aren't worth sending
+    if( layout->nb_sensors[is_vr] == 0 )
+    {
+        return 0;
+    }
+
+    return ( layout->nb_values[is_vr] + chunk_values - 1 ) / chunk_values;
+}
+
+/**
+ * Returns the number of chunks of both kinds.
+ */
+static unsigned long _phdeem_nb_all_chunks( const _phdeem_layout_t* layout,
+                                            unsigned long chunk_values )
+{
+    return _phdeem_nb_chunks( layout, 0, chunk_values ) +
+           _phdeem_nb_chunks( layout, 1, chunk_values );
+}
+
+/**
+ * Fills in kind, position and size of the chunk with the given index.
+ *
+ * The blade chunks come first, followed by the VR chunks.
+ */
+static void _phdeem_chunk_at( const _phdeem_layout_t* layout, unsigned long chunk_values,
+                              unsigned long index, phdeem_chunk_t* chunk )
+{
+    unsigned long nb_blade_chunks = _phdeem_nb_chunks( layout, 0, chunk_values );
+
+    chunk->is_vr = index >= nb_blade_chunks;
+    if( chunk->is_vr )
+    {
+        index -= nb_blade_chunks;
+    }
+
+    chunk->first_value = index * chunk_values;
+    chunk->total_values = layout->nb_values[chunk->is_vr];
+    chunk->nb_values = chunk->total_values - chunk->first_value;
+    if( chunk->nb_values > chunk_values )
+    {
+        chunk->nb_values = chunk_values;
+    }
+    chunk->nb_sensors = layout->nb_sensors[chunk->is_vr];
+}
+
+/**
+ * Copies the values of a chunk from the hdeem readings into a contiguous buffer.
+ */
+static void _phdeem_pack( const hdeem_global_reading_t* hdeem_read, const phdeem_chunk_t* chunk,
+                          float* buffer )
+{
+    const hdeem_sensor_reading_t* samples = chunk->is_vr ? hdeem_read->vr : hdeem_read->blade;
+
+    for( unsigned long i = 0; i < chunk->nb_values; ++i )
+    {
+        for( unsigned long s = 0; s < chunk->nb_sensors; ++s )
+        {
+            buffer[i * chunk->nb_sensors + s] = samples[chunk->first_value + i].value[s];
+        }
+    }
+}
+
+/**
+ * Allocates nb_buffers buffers of size values. Returns whether this succeeded.
+ */
+static int _phdeem_alloc( float** buffers, int nb_buffers, unsigned long size )
+{
+    int ok = 1;
+
+    for( int i = 0; i < nb_buffers; ++i )
+    {
+        buffers[i] = size > 0 ? malloc( size * sizeof( float ) ) : NULL;
+        ok = ok && ( size == 0 || buffers[i] != NULL );
+    }
+
+    return ok;
+}
+
+/**
+ * Returns the larger sensor count of a layout.
+ */
+static unsigned long _phdeem_max_sensors( const _phdeem_layout_t* layout )
+{
+    return layout->nb_sensors[0] > layout->nb_sensors[1] ? layout->nb_sensors[0] :
+                                                           layout->nb_sensors[1];
+}
+
+/**
+ * Sends the readings of a node root to the collector, see _phdeem_collect().
+ *
+ * The collector grants a credit for every chunk after having posted the receive for it. Packing
+ * the next chunk overlaps with sending the previous one.
+ */
+static int _phdeem_send( const hdeem_global_reading_t* hdeem_read, const _phdeem_layout_t* layout,
+                         MPI_Comm comm, int collector, unsigned long chunk_values,
+                         float* buffers[2] )
+{
+    MPI_Request requests[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+
+    int ret = MPI_Send( (void*) layout, 4, MPI_UNSIGNED_LONG, collector, PHDEEM_GATHER_TAG_LAYOUT,
+                        comm );
+    if( ret != MPI_SUCCESS )
+    {
+        return ret;
+    }
+
+    unsigned long nb_chunks = _phdeem_nb_all_chunks( layout, chunk_values );
+
+    for( unsigned long i = 0; i < nb_chunks; ++i )
+    {
+        phdeem_chunk_t chunk;
+        int buffer = i % 2;
+
+        // Wait until the buffer's previous chunk is gone, then fill it
+        ret = MPI_Wait( &requests[buffer], MPI_STATUS_IGNORE );
+        if( ret != MPI_SUCCESS )
+        {
+            return ret;
+        }
+
+        _phdeem_chunk_at( layout, chunk_values, i, &chunk );
+        _phdeem_pack( hdeem_read, &chunk, buffers[buffer] );
+
+        ret = MPI_Recv( NULL, 0, MPI_BYTE, collector, PHDEEM_GATHER_TAG_CREDIT, comm,
+                        MPI_STATUS_IGNORE );
+        if( ret != MPI_SUCCESS )
+        {
+            return ret;
+        }
+
+        // phdeem_gather_global() made sure the count fits into an int
+        ret = MPI_Isend( buffers[buffer], (int) ( chunk.nb_values * chunk.nb_sensors ), MPI_FLOAT,
+                         collector, PHDEEM_GATHER_TAG_CHUNK, comm, &requests[buffer] );
+        if( ret != MPI_SUCCESS )
+        {
+            return ret;
+        }
+    }
+
+    return MPI_Waitall( 2, requests, MPI_STATUSES_IGNORE );
+}
+
+/**
+ * Posts the receive for the next chunk of a node root and grants it the credit to send it.
+ */
+static int _phdeem_request_chunk( _phdeem_slot_t* slot, int buffer, unsigned long chunk_values,
+                                  MPI_Comm comm, MPI_Request* request )
+{
+    phdeem_chunk_t* chunk = &slot->chunks[buffer];
+
+    _phdeem_chunk_at( &slot->layout, chunk_values, slot->requested++, chunk );
+    chunk->source = slot->source;
+    chunk->values = slot->buffers[buffer];
+
+    int ret = MPI_Irecv( slot->buffers[buffer], (int) ( chunk->nb_values * chunk->nb_sensors ),
+                         MPI_FLOAT, slot->source, PHDEEM_GATHER_TAG_CHUNK, comm, request );
+    if( ret != MPI_SUCCESS )
+    {
+        return ret;
+    }
+
+    return MPI_Send( NULL, 0, MPI_BYTE, slot->source, PHDEEM_GATHER_TAG_CREDIT, comm );
+}
+
+/**
+ * Receives the readings of nb_senders node roots on the collector, see _phdeem_send().
+ *
+ * Up to PHDEEM_GATHER_SENDERS node roots are served at the same time, each with at most two
+ * chunks requested. So the transfers from several nodes and the callback overlap, while the
+ * memory needed stays bounded. A slot whose node root is done takes the next one announcing
+ * itself.
+ */
+static int _phdeem_collect( int nb_senders, MPI_Comm comm, unsigned long chunk_values,
+                            phdeem_chunk_callback_t callback, void* user_data,
+                            _phdeem_slot_t slots[PHDEEM_GATHER_SENDERS] )
+{
+    int ret;
+    int accepted = 0;
+    int active = 0;
+    MPI_Request requests[2 * PHDEEM_GATHER_SENDERS];
+
+    // Slot s uses requests 2 * s and 2 * s + 1, the first one for the layout, too
+    for( int s = 0; s < PHDEEM_GATHER_SENDERS; ++s )
+    {
+        requests[2 * s] = requests[2 * s + 1] = MPI_REQUEST_NULL;
+        slots[s].streaming = 0;
+
+        if( accepted < nb_senders )
+        {
+            ret = MPI_Irecv( &slots[s].layout, 4, MPI_UNSIGNED_LONG, MPI_ANY_SOURCE,
+                             PHDEEM_GATHER_TAG_LAYOUT, comm, &requests[2 * s] );
+            if( ret != MPI_SUCCESS )
+            {
+                return ret;
+            }
+            accepted++;
+            active++;
+        }
+    }
+
+    while( active > 0 )
+    {
+        int index;
+        MPI_Status status;
+        ret = MPI_Waitany( 2 * PHDEEM_GATHER_SENDERS, requests, &index, &status );
+        if( ret != MPI_SUCCESS )
+        {
+            return ret;
+        }
+
+        _phdeem_slot_t* slot = &slots[index / 2];
+        int buffer = index % 2;
+
+        if( !slot->streaming )
+        {
+            // A node root announced itself, request its first two chunks
+            slot->streaming = 1;
+            slot->source = status.MPI_SOURCE;
+            slot->nb_chunks = _phdeem_nb_all_chunks( &slot->layout, chunk_values );
+            slot->requested = 0;
+            slot->delivered = 0;
+
+            for( int b = 0; b < 2 && slot->requested < slot->nb_chunks; ++b )
+            {
+                ret = _phdeem_request_chunk( slot, b, chunk_values, comm,
+                                             &requests[index - buffer + b] );
+                if( ret != MPI_SUCCESS )
+                {
+                    return ret;
+                }
+            }
+        }
+        else
+        {
+            callback( &slot->chunks[buffer], user_data );
+            slot->delivered++;
+
+            // The buffer is free again, so request the next chunk into it
+            if( slot->requested < slot->nb_chunks )
+            {
+                ret = _phdeem_request_chunk( slot, buffer, chunk_values, comm, &requests[index] );
+                if( ret != MPI_SUCCESS )
+                {
+                    return ret;
+                }
+            }
+        }
+
+        if( slot->streaming && slot->delivered == slot->nb_chunks )
+        {
+            slot->streaming = 0;
+            active--;
+
+            if( accepted < nb_senders )
+            {
+                ret = MPI_Irecv( &slot->layout, 4, MPI_UNSIGNED_LONG, MPI_ANY_SOURCE,
+                                 PHDEEM_GATHER_TAG_LAYOUT, comm, &requests[index - buffer] );
+                if( ret != MPI_SUCCESS )
+                {
+                    return ret;
+                }
+                accepted++;
+                active++;
+            }
+        }
+    }
+
+    return MPI_SUCCESS;
+}
+
+/**
+ * Passes the collector's own readings to the callback without going through MPI.
+ */
+static void _phdeem_collect_local( const hdeem_global_reading_t* hdeem_read,
+                                   const _phdeem_layout_t* layout, int rank,
+                                   unsigned long chunk_values, phdeem_chunk_callback_t callback,
+                                   void* user_data, float* buffer )
+{
+    unsigned long nb_chunks = _phdeem_nb_all_chunks( layout, chunk_values );
+
+    for( unsigned long i = 0; i < nb_chunks; ++i )
+    {
+        phdeem_chunk_t chunk;
+        chunk.source = rank;
+        _phdeem_chunk_at( layout, chunk_values, i, &chunk );
+        _phdeem_pack( hdeem_read, &chunk, buffer );
+        chunk.values = buffer;
+        callback( &chunk, user_data );
+    }
+}
+
+int phdeem_gather_global( hdeem_bmc_data_t* hdeem_data, hdeem_global_reading_t* hdeem_read,
+                          const phdeem_info_t* info, MPI_Comm comm, int collector,
+                          unsigned long chunk_values, phdeem_chunk_callback_t callback,
+                          void* user_data, phdeem_status_t* ret_val )
+{
+    // Reset the return values
+    ret_val->hdeem_ret_value = 0;
+    ret_val->mpi_ret_value = MPI_SUCCESS;
+
+    if( chunk_values == 0 )
+    {
+        ret_val->mpi_ret_value = MPI_ERR_COUNT;
+        return PHDEEM_MPI_ERROR;
+    }
+
+    // Use our own communicator, so the messages can't be mixed up with the application's ones
+    MPI_Comm gather_comm;
+    ret_val->mpi_ret_value = MPI_Comm_dup( comm, &gather_comm );
+    if( ret_val->mpi_ret_value != MPI_SUCCESS )
+    {
+        return PHDEEM_MPI_ERROR;
+    }
+
+    int rank;
+    ret_val->mpi_ret_value = MPI_Comm_rank( gather_comm, &rank );
+    if( ret_val->mpi_ret_value != MPI_SUCCESS )
+    {
+        MPI_Comm_free( &gather_comm );
+        return PHDEEM_MPI_ERROR;
+    }
+
+    int is_root = info->node_rank == 0;
+    int is_collector = rank == collector;
+    int is_sender = is_root && !is_collector;
+
+    _phdeem_layout_t layout;
+    unsigned long max_sensors = 0;
+    if( is_root )
+    {
+        layout.nb_values[0] = hdeem_read->nb_blade_values;
+        layout.nb_values[1] = hdeem_read->nb_vr_values;
+        layout.nb_sensors[0] = hdeem_data->nb_blade_sensors;
+        layout.nb_sensors[1] = hdeem_data->nb_vr_sensors;
+        max_sensors = _phdeem_max_sensors( &layout );
+    }
+
+    // Let the collector know how many node roots are going to send, and everybody how large the
+    // largest chunk will be
+    int nb_senders = 0;
+    ret_val->mpi_ret_value = MPI_Reduce( &is_sender, &nb_senders, 1, MPI_INT, MPI_SUM, collector,
+                                         gather_comm );
+    if( ret_val->mpi_ret_value == MPI_SUCCESS )
+    {
+        ret_val->mpi_ret_value = MPI_Allreduce( MPI_IN_PLACE, &max_sensors, 1, MPI_UNSIGNED_LONG,
+                                                MPI_MAX, gather_comm );
+    }
+    if( ret_val->mpi_ret_value != MPI_SUCCESS )
+    {
+        MPI_Comm_free( &gather_comm );
+        return PHDEEM_MPI_ERROR;
+    }
+
+    // The chunk size is passed to MPI as an int. Everybody knows max_sensors, so everybody fails.
+    if( max_sensors > 0 && ( chunk_values > INT_MAX / max_sensors ||
+                             chunk_values > SIZE_MAX / sizeof( float ) / max_sensors ) )
+    {
+        MPI_Comm_free( &gather_comm );
+        ret_val->mpi_ret_value = MPI_ERR_COUNT;
+        return PHDEEM_MPI_ERROR;
+    }
+
+    _phdeem_slot_t slots[PHDEEM_GATHER_SENDERS];
+    float* buffers[2] = { NULL, NULL };
+    int ok = 1;
+
+    memset( slots, 0, sizeof( slots ) );
+    if( is_collector )
+    {
+        for( int s = 0; s < PHDEEM_GATHER_SENDERS; ++s )
+        {
+            ok = _phdeem_alloc( slots[s].buffers, 2, chunk_values * max_sensors ) && ok;
+        }
+    }
+    else if( is_sender )
+    {
+        ok = _phdeem_alloc( buffers, 2, chunk_values * max_sensors );
+    }
+
+    // Nobody may start streaming unless all buffers are there, otherwise the others would wait
+    // for them forever
+    ret_val->mpi_ret_value = MPI_Allreduce( MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, gather_comm );
+    if( ret_val->mpi_ret_value == MPI_SUCCESS && !ok )
+    {
+        ret_val->mpi_ret_value = MPI_ERR_NO_MEM;
+    }
+
+    if( ret_val->mpi_ret_value == MPI_SUCCESS )
+    {
+        if( is_sender )
+        {
+            ret_val->mpi_ret_value = _phdeem_send( hdeem_read, &layout, gather_comm, collector,
+                                                   chunk_values, buffers );
+        }
+        else if( is_collector )
+        {
+            // Our own readings don't need to go through MPI
+            if( is_root )
+            {
+                _phdeem_collect_local( hdeem_read, &layout, rank, chunk_values, callback,
+                                       user_data, slots[0].buffers[0] );
+            }
+
+            ret_val->mpi_ret_value = _phdeem_collect( nb_senders, gather_comm, chunk_values,
+                                                      callback, user_data, slots );
+        }
+    }
+
+    for( int s = 0; s < PHDEEM_GATHER_SENDERS; ++s )
+    {
+        free( slots[s].buffers[0] );
+        free( slots[s].buffers[1] );
+    }
+    free( buffers[0] );
+    free( buffers[1] );
+    MPI_Comm_free( &gather_comm );
+
+    if( ret_val->mpi_ret_value != MPI_SUCCESS )
+    {
+        return PHDEEM_MPI_ERROR;
+    }
+
+    if( !is_root && !is_collector )
+    {
+        return PHDEEM_NOT_ROOT;
+    }
+
+    return PHDEEM_SUCCESS;
+}
+
+/**
+ * The readings phdeem_write_trace() writes.
+ */
+typedef struct _phdeem_trace_source
+{
+    const hdeem_global_reading_t* hdeem_read;
+    int nb_sensors;
+} _phdeem_trace_source_t;
+
+/**
+ * Copies the blade values of a sample for phdeem_trace_write().
+ */
+static void _phdeem_trace_sample( uint64_t index, float* values, void* user_data )
+{
+    const _phdeem_trace_source_t* source = user_data;
+    const hdeem_sensor_reading_t* sample = &source->hdeem_read->blade[index];
+
+    for( int s = 0; s < source->nb_sensors; ++s )
+    {
+        values[s] = sample->value[s];
+    }
+}
+
+int phdeem_write_trace( const char* path, const hdeem_bmc_data_t* hdeem_data,
+                        const hdeem_global_reading_t* hdeem_read,
+                        const phdeem_trace_region_t* regions, unsigned int nb_regions,
+                        const phdeem_info_t* info, phdeem_status_t* ret_val )
+{
+    // Reset the return values
+    ret_val->hdeem_ret_value = 0;
+    ret_val->mpi_ret_value = MPI_SUCCESS;
+
+    // If we're not root, exit immediately
+    if( info->node_rank != 0 )
+    {
+        return PHDEEM_NOT_ROOT;
+    }
+
+    int resultlen;
+    char hostname[MPI_MAX_PROCESSOR_NAME];
+    ret_val->mpi_ret_value = MPI_Get_processor_name( hostname, &resultlen );
+    if( ret_val->mpi_ret_value != MPI_SUCCESS )
+    {
+        return PHDEEM_MPI_ERROR;
+    }
+
+    _phdeem_trace_source_t source = { hdeem_read, hdeem_data->nb_blade_sensors };
+    if( phdeem_trace_write( path, hostname, _phdeem_blade_sampling_rate,
+                            hdeem_data->nb_blade_sensors,
+                            (const char* const*) hdeem_data->name_blade_sensors, regions,
+                            nb_regions, hdeem_read->nb_blade_values, _phdeem_trace_sample,
+                            &source ) != 0 )
+    {
+        return PHDEEM_IO_ERROR;
+    }
+
+    return PHDEEM_SUCCESS;
+}
+
 int phdeem_get_stats( hdeem_bmc_data_t* hdeem_data, hdeem_stats_reading_t* hdeem_read,
                       const phdeem_info_t* info, phdeem_status_t* ret_val )
 {
@@ -34,6 +34,11 @@
 
 #include <time.h>
 
+#include "phdeem_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
  * Stores necessary information about the calling process.
@@ -48,6 +53,8 @@ typedef struct phdeem_info
     int node_rank;
     /** The sub communicator the caller is in */
     MPI_Comm sub_comm;
+    /** Whether the caller uses the BMC connection shared between sessions */
+    int shared_connection;
 } phdeem_info_t;
 
 /**
@@ -64,16 +71,52 @@ typedef struct phdeem_status
  *
  * When no errors occurred, PHDEEM_SUCCESS will be returned. If the caller isn't the root process,
  * PHDEEM_NOT_ROOT will be returned. On errors, PHDEEM_HDEEM_ERROR or PHDEEM_MPI_ERROR resp. will be
- * returned. On errors, take a look at the phdeem_status_t passed.
+ * returned. On errors, take a look at the phdeem_status_t passed. PHDEEM_IO_ERROR is returned if
+ * writing a file failed, errno tells why. PHDEEM_CONNECTION_ERROR is returned by phdeem_init() if
+ * the BMC connection of this process is in use by another session with different parameters.
  */
 enum phdeem_return_values
 {
     PHDEEM_SUCCESS          = 0,
     PHDEEM_NOT_ROOT         = 1,
     PHDEEM_HDEEM_ERROR      = 2,
-    PHDEEM_MPI_ERROR        = 3
+    PHDEEM_MPI_ERROR        = 3,
+    PHDEEM_IO_ERROR         = 4,
+    PHDEEM_CONNECTION_ERROR = 5
 };
 
+/**
+ * A chunk of readings as passed to a phdeem_chunk_callback_t by phdeem_gather_global().
+ */
+typedef struct phdeem_chunk
+{
+    /** The rank of the node root the values come from */
+    int source;
+    /** 0 for blade values, 1 for VR values */
+    int is_vr;
+    /** The index of the first sample in the chunk */
+    unsigned long first_value;
+    /** The number of samples in the chunk */
+    unsigned long nb_values;
+    /** The total number of samples of this kind on the source */
+    unsigned long total_values;
+    /** The number of sensors per sample */
+    unsigned long nb_sensors;
+    /** nb_values * nb_sensors values, sample by sample. Only valid during the callback. */
+    const float* values;
+} phdeem_chunk_t;
+
+/** The number of node roots phdeem_gather_global() receives from at the same time */
+#define PHDEEM_GATHER_SENDERS   4
+
+/**
+ * Called by phdeem_gather_global() on the collector for every chunk received.
+ *
+ * @param chunk         The chunk received.
+ * @param user_data     The user_data passed to phdeem_gather_global().
+ */
+typedef void ( *phdeem_chunk_callback_t )( const phdeem_chunk_t* chunk, void* user_data );
+
 /**
  * Initializes the phdeem library.
  *
@@ -81,6 +124,20 @@ enum phdeem_return_values
  * processes in their corresponding communicators. Afterwards hdeem_init() is called for the root
  * processes in the new communicators.
  *
+ * The BMC connection set up by hdeem_init() is kept open by phdeem_close() and reused by all
+ * following calls to phdeem_init() in this process with the same hasGPIO, host, user and password,
+ * which then just copy the connection data into hdeem_data. If these parameters differ, an unused
+ * connection is closed and a new one set up, while a connection still used by another session
+ * makes this function return PHDEEM_CONNECTION_ERROR. In that case the node local communicator
+ * is freed again and info marks the caller as not root, so a following phdeem_close() just returns
+ * PHDEEM_NOT_ROOT. See phdeem_disconnect().
+ *
+ * Processes which aren't root on their node in current_comm release an unused connection kept from
+ * an earlier session, so the new root can connect. A connection kept by a process which isn't part
+ * of current_comm, or which is still in use by another session, isn't released though, and the
+ * BMC might refuse the new root's hdeem_init(). Call phdeem_disconnect() in such processes or set
+ * PHDEEM_PERSISTENT_CONNECTION to 0 if the node roots of your communicators differ.
+ *
  * @param hdeem_data    Information that otherwise would have been passed to hdeem_init().
  * @param info          An empty phdeem_info_t. All necessary information will be stored in this
  *                      struct.
@@ -95,7 +152,9 @@ int phdeem_init( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, MPI_Comm cur
 /**
  * Finalizes the phdeem library.
  *
- * Calls hdeem_close.
+ * Frees the node local communicator. The BMC connection is kept open for the next phdeem_init()
+ * unless the environment variable PHDEEM_PERSISTENT_CONNECTION is set to 0, in which case
+ * hdeem_close() is called.
  *
  * @param hdeem_data    Information that otherwise would have been passed to hdeem_close().
  * @param info          phdeem_info_t holding the caller's information.
@@ -105,6 +164,23 @@ int phdeem_init( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, MPI_Comm cur
  */
 int phdeem_close( hdeem_bmc_data_t* hdeem_data, phdeem_info_t* info, phdeem_status_t* ret_val );
 
+/**
+ * Closes the BMC connection kept open by phdeem_close().
+ *
+ * Calls hdeem_close() if this process holds an open connection. If sessions are still using it,
+ * the connection is closed by the phdeem_close() of the last one instead. This is done
+ * automatically at process exit, so you only need to call this if you want to release the BMC
+ * earlier, e.g. for other tools accessing it. A following phdeem_init() sets up a new connection.
+ *
+ * This function is process local, it doesn't need to be called by all processes.
+ *
+ * @param ret_val       The phdeem_status_t the return values are stored in.
+ *
+ * @return              PHDEEM_SUCCESS if a connection was closed or will be closed by the last
+ *                      session using it, PHDEEM_NOT_ROOT if there was none.
+ */
+int phdeem_disconnect( phdeem_status_t* ret_val );
+
 /**
  * Calls hdeem_start().
  *
@@ -163,6 +239,64 @@ int phdeem_check_status( hdeem_bmc_data_t* hdeem_data, hdeem_status_t* hdeem_sta
 int phdeem_get_global( hdeem_bmc_data_t* hdeem_data, hdeem_global_reading_t* hdeem_read,
                        const phdeem_info_t* info, phdeem_status_t* ret_val );
 
+/**
+ * Streams the readings of all node roots to a collector process.
+ *
+ * Every node root sends the blade and VR readings previously read with phdeem_get_global() in
+ * chunks of chunk_values samples. The collector hands each chunk to the callback as soon as it has
+ * arrived. It receives from up to PHDEEM_GATHER_SENDERS node roots at the same time with at most
+ * two chunks in flight each, so the transfers overlap with each other and with the callback, while
+ * the memory needed on the collector only depends on chunk_values, not on the number of nodes or
+ * the length of the readings. The chunks of one node root are passed in order, but chunks of
+ * different node roots interleave. If the collector is a node root itself, its own readings are
+ * passed to the callback first.
+ *
+ * This function is collective, all processes in comm have to call it. The node roots of all
+ * nodes the readings should be gathered from have to be part of comm. The messages are sent on a
+ * duplicate of comm, so they don't interfere with other messages on comm.
+ *
+ * If a process can't allocate its buffers, all processes return PHDEEM_MPI_ERROR with
+ * MPI_ERR_NO_MEM. If chunk_values is 0 or chunk_values times the number of sensors exceeds
+ * INT_MAX, all processes return PHDEEM_MPI_ERROR with MPI_ERR_COUNT.
+ *
+ * @param hdeem_data    The hdeem_bmc_data_t the readings were read with. Only used on node roots.
+ * @param hdeem_read    The readings to send. Only used on node roots.
+ * @param info          phdeem_info_t holding the caller's information.
+ * @param comm          The communicator to gather over.
+ * @param collector     The rank in comm receiving the readings.
+ * @param chunk_values  The number of samples per chunk.
+ * @param callback      The function called for every chunk. Only used on the collector.
+ * @param user_data     Passed to callback.
+ * @param ret_val       The phdeem_status_t the return values are stored in.
+ *
+ * @return              A phdeem return value. PHDEEM_NOT_ROOT is returned on processes which
+ *                      neither are a node root nor the collector.
+ */
+int phdeem_gather_global( hdeem_bmc_data_t* hdeem_data, hdeem_global_reading_t* hdeem_read,
+                          const phdeem_info_t* info, MPI_Comm comm, int collector,
+                          unsigned long chunk_values, phdeem_chunk_callback_t callback,
+                          void* user_data, phdeem_status_t* ret_val );
+
+/**
+ * Writes the blade readings to a trace file, see phdeem_trace.h.
+ *
+ * The trace can be analyzed offline with phdeem-analyze.
+ *
+ * @param path          The path of the file to write, an existing file is overwritten.
+ * @param hdeem_data    The hdeem_bmc_data_t the readings were read with.
+ * @param hdeem_read    The readings returned by phdeem_get_global().
+ * @param regions       nb_regions regions in blade sample indices, may be NULL if nb_regions is 0.
+ * @param nb_regions    The number of regions.
+ * @param info          phdeem_info_t holding the caller's information.
+ * @param ret_val       The phdeem_status_t the return values are stored in.
+ *
+ * @return              A phdeem return value.
+ */
+int phdeem_write_trace( const char* path, const hdeem_bmc_data_t* hdeem_data,
+                        const hdeem_global_reading_t* hdeem_read,
+                        const phdeem_trace_region_t* regions, unsigned int nb_regions,
+                        const phdeem_info_t* info, phdeem_status_t* ret_val );
+
 /**
  * Calls hdeem_get_stats().
  *
@@ -220,4 +354,8 @@ int phdeem_stats_free( hdeem_stats_reading_t* hdeem_read, const phdeem_info_t* i
 int phdeem_clear( hdeem_bmc_data_t* hdeem_data, const phdeem_info_t* info,
                   phdeem_status_t* ret_val );
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* PHDEEM_H */
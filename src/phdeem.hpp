@@ -0,0 +1,578 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PHDEEM_HPP
+#define PHDEEM_HPP
+
+#include "phdeem.h"
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+
+/**
+ * Header only C++ interface to phdeem.
+ *
+ * Sessions and readings are RAII handles around the C interface. The sensor values are accessed
+ * through non-owning views and iterators directly on the buffers libhdeem returns, so no values
+ * are copied. The sensor kind (blade or VR) is chosen at compile time with the tag types
+ * phdeem::blade and phdeem::vr.
+ */
+namespace phdeem
+{
+
+/**
+ * Thrown when phdeem reports an error in MPI or libhdeem.
+ */
+class error : public std::runtime_error
+{
+public:
+    error( const std::string& what, int ret, const phdeem_status_t& status )
+    : std::runtime_error( what ), ret_( ret ), status_( status )
+    {
+    }
+
+    /** The phdeem return value, i.e. PHDEEM_HDEEM_ERROR or PHDEEM_MPI_ERROR */
+    int ret( ) const
+    {
+        return ret_;
+    }
+
+    /** The return values of the failed MPI or libhdeem call */
+    const phdeem_status_t& status( ) const
+    {
+        return status_;
+    }
+
+private:
+    int ret_;
+    phdeem_status_t status_;
+};
+
+namespace detail
+{
+
+/**
+ * Throws on errors and returns whether the call was actually made, i.e. the caller is root.
+ */
+inline bool check( int ret, const phdeem_status_t& status, const char* function )
+{
+    switch( ret )
+    {
+        case PHDEEM_SUCCESS:
+            return true;
+        case PHDEEM_NOT_ROOT:
+            return false;
+        case PHDEEM_MPI_ERROR:
+            throw error( std::string( function ) + ": MPI error", ret, status );
+        case PHDEEM_CONNECTION_ERROR:
+            throw error( std::string( function ) + ": BMC connection in use with other parameters",
+                         ret, status );
+        default:
+            throw error( std::string( function ) + ": hdeem error", ret, status );
+    }
+}
+
+} // namespace detail
+
+/** Tag type selecting the blade sensors */
+struct blade
+{
+};
+
+/** Tag type selecting the voltage regulator sensors */
+struct vr
+{
+};
+
+/**
+ * Maps a sensor kind to the corresponding members of the libhdeem structs.
+ */
+template <typename Kind>
+struct sensor_traits;
+
+template <>
+struct sensor_traits<blade>
+{
+    static const hdeem_sensor_reading_t* samples( const hdeem_global_reading_t& read )
+    {
+        return read.blade;
+    }
+
+    static std::size_t nb_values( const hdeem_global_reading_t& read )
+    {
+        return read.nb_blade_values;
+    }
+
+    static std::size_t nb_sensors( const hdeem_bmc_data_t& data )
+    {
+        return data.nb_blade_sensors;
+    }
+
+    static const char* name( const hdeem_bmc_data_t& data, std::size_t sensor )
+    {
+        return data.name_blade_sensors[sensor];
+    }
+};
+
+template <>
+struct sensor_traits<vr>
+{
+    static const hdeem_sensor_reading_t* samples( const hdeem_global_reading_t& read )
+    {
+        return read.vr;
+    }
+
+    static std::size_t nb_values( const hdeem_global_reading_t& read )
+    {
+        return read.nb_vr_values;
+    }
+
+    static std::size_t nb_sensors( const hdeem_bmc_data_t& data )
+    {
+        return data.nb_vr_sensors;
+    }
+
+    static const char* name( const hdeem_bmc_data_t& data, std::size_t sensor )
+    {
+        return data.name_vr_sensors[sensor];
+    }
+};
+
+/**
+ * Random access iterator over the values of a single sensor.
+ *
+ * libhdeem stores all sensors of a sample together, so this steps through the samples and picks
+ * the value of one sensor from each.
+ */
+class sensor_iterator
+{
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef std::decay<decltype( std::declval<hdeem_sensor_reading_t>( ).value[0] )>::type
+        value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
+
+    sensor_iterator( ) : sample_( nullptr ), sensor_( 0 )
+    {
+    }
+
+    sensor_iterator( const hdeem_sensor_reading_t* sample, std::size_t sensor )
+    : sample_( sample ), sensor_( sensor )
+    {
+    }
+
+    reference operator*( ) const
+    {
+        return sample_->value[sensor_];
+    }
+
+    pointer operator->( ) const
+    {
+        return &sample_->value[sensor_];
+    }
+
+    reference operator[]( difference_type n ) const
+    {
+        return sample_[n].value[sensor_];
+    }
+
+    sensor_iterator& operator++( )
+    {
+        ++sample_;
+        return *this;
+    }
+
+    sensor_iterator operator++( int )
+    {
+        sensor_iterator tmp( *this );
+        ++sample_;
+        return tmp;
+    }
+
+    sensor_iterator& operator--( )
+    {
+        --sample_;
+        return *this;
+    }
+
+    sensor_iterator operator--( int )
+    {
+        sensor_iterator tmp( *this );
+        --sample_;
+        return tmp;
+    }
+
+    sensor_iterator& operator+=( difference_type n )
+    {
+        sample_ += n;
+        return *this;
+    }
+
+    sensor_iterator& operator-=( difference_type n )
+    {
+        sample_ -= n;
+        return *this;
+    }
+
+    friend sensor_iterator operator+( sensor_iterator it, difference_type n )
+    {
+        return it += n;
+    }
+
+    friend sensor_iterator operator+( difference_type n, sensor_iterator it )
+    {
+        return it += n;
+    }
+
+    friend sensor_iterator operator-( sensor_iterator it, difference_type n )
+    {
+        return it -= n;
+    }
+
+    friend difference_type operator-( const sensor_iterator& a, const sensor_iterator& b )
+    {
+        return a.sample_ - b.sample_;
+    }
+
+    friend bool operator==( const sensor_iterator& a, const sensor_iterator& b )
+    {
+        return a.sample_ == b.sample_;
+    }
+
+    friend bool operator!=( const sensor_iterator& a, const sensor_iterator& b )
+    {
+        return a.sample_ != b.sample_;
+    }
+
+    friend bool operator<( const sensor_iterator& a, const sensor_iterator& b )
+    {
+        return a.sample_ < b.sample_;
+    }
+
+    friend bool operator>( const sensor_iterator& a, const sensor_iterator& b )
+    {
+        return a.sample_ > b.sample_;
+    }
+
+    friend bool operator<=( const sensor_iterator& a, const sensor_iterator& b )
+    {
+        return a.sample_ <= b.sample_;
+    }
+
+    friend bool operator>=( const sensor_iterator& a, const sensor_iterator& b )
+    {
+        return a.sample_ >= b.sample_;
+    }
+
+private:
+    const hdeem_sensor_reading_t* sample_;
+    std::size_t sensor_;
+};
+
+/**
+ * Non-owning view of the values of a single sensor.
+ *
+ * Only valid as long as the global_readings it was taken from are alive.
+ */
+template <typename Kind>
+class sensor_view
+{
+public:
+    typedef sensor_iterator iterator;
+    typedef sensor_iterator const_iterator;
+    typedef sensor_iterator::value_type value_type;
+    typedef std::size_t size_type;
+
+    sensor_view( const hdeem_bmc_data_t& data, const hdeem_global_reading_t& read,
+                 std::size_t sensor )
+    : data_( &data ), read_( &read ), sensor_( sensor )
+    {
+    }
+
+    /** The name of the sensor as reported by libhdeem */
+    const char* name( ) const
+    {
+        return sensor_traits<Kind>::name( *data_, sensor_ );
+    }
+
+    iterator begin( ) const
+    {
+        return iterator( sensor_traits<Kind>::samples( *read_ ), sensor_ );
+    }
+
+    iterator end( ) const
+    {
+        return begin( ) + size( );
+    }
+
+    size_type size( ) const
+    {
+        return sensor_traits<Kind>::nb_values( *read_ );
+    }
+
+    bool empty( ) const
+    {
+        return size( ) == 0;
+    }
+
+    const value_type& operator[]( size_type i ) const
+    {
+        return begin( )[i];
+    }
+
+private:
+    const hdeem_bmc_data_t* data_;
+    const hdeem_global_reading_t* read_;
+    std::size_t sensor_;
+};
+
+/**
+ * Non-owning view of all sensors of one kind, indexable by the sensor number.
+ */
+template <typename Kind>
+class readings_view
+{
+public:
+    typedef std::size_t size_type;
+
+    readings_view( const hdeem_bmc_data_t& data, const hdeem_global_reading_t& read,
+                   size_type nb_sensors )
+    : data_( &data ), read_( &read ), nb_sensors_( nb_sensors )
+    {
+    }
+
+    /** The number of sensors */
+    size_type size( ) const
+    {
+        return nb_sensors_;
+    }
+
+    /** The values of the given sensor */
+    sensor_view<Kind> operator[]( size_type sensor ) const
+    {
+        return sensor_view<Kind>( *data_, *read_, sensor );
+    }
+
+private:
+    const hdeem_bmc_data_t* data_;
+    const hdeem_global_reading_t* read_;
+    size_type nb_sensors_;
+};
+
+class session;
+
+/**
+ * Owns the readings of one phdeem_get_global() call and frees them on destruction.
+ *
+ * On processes which aren't root on their node, the readings are empty.
+ */
+class global_readings
+{
+public:
+    global_readings( global_readings&& other ) noexcept
+    : session_( other.session_ ), read_( other.read_ ), valid_( other.valid_ )
+    {
+        other.valid_ = false;
+    }
+
+    global_readings( const global_readings& ) = delete;
+    global_readings& operator=( const global_readings& ) = delete;
+    global_readings& operator=( global_readings&& ) = delete;
+
+    inline ~global_readings( );
+
+    /** Whether there are any readings, i.e. the caller is root on its node */
+    bool valid( ) const
+    {
+        return valid_;
+    }
+
+    /** The underlying libhdeem readings */
+    const hdeem_global_reading_t& get( ) const
+    {
+        return read_;
+    }
+
+    /** All sensors of the given kind */
+    template <typename Kind>
+    inline readings_view<Kind> sensors( ) const;
+
+    readings_view<blade> blade_sensors( ) const
+    {
+        return sensors<blade>( );
+    }
+
+    readings_view<vr> vr_sensors( ) const
+    {
+        return sensors<vr>( );
+    }
+
+private:
+    friend class session;
+
+    explicit global_readings( session& s ) : session_( &s ), read_( ), valid_( false )
+    {
+    }
+
+    session* session_;
+    hdeem_global_reading_t read_;
+    bool valid_;
+};
+
+/**
+ * A phdeem session, calls phdeem_init() on construction and phdeem_close() on destruction.
+ *
+ * The session must outlive all global_readings taken from it. All member functions are collective
+ * in the sense of the C interface, they only do something on the root process of each node.
+ */
+class session
+{
+public:
+    /**
+     * @param data  Information that otherwise would have been passed to phdeem_init().
+     * @param comm  The process' current MPI communicator.
+     */
+    session( const hdeem_bmc_data_t& data, MPI_Comm comm ) : data_( data ), info_( )
+    {
+        info_.sub_comm = MPI_COMM_NULL;
+
+        phdeem_status_t status;
+        int ret = phdeem_init( &data_, &info_, comm, &status );
+        try
+        {
+            root_ = detail::check( ret, status, "phdeem_init" );
+        }
+        catch( const error& )
+        {
+            // The destructor won't run, so free the node communicator if it has been created
+            if( info_.sub_comm != MPI_COMM_NULL )
+            {
+                MPI_Comm_free( &info_.sub_comm );
+            }
+            throw;
+        }
+    }
+
+    ~session( )
+    {
+        phdeem_status_t status;
+        phdeem_close( &data_, &info_, &status );
+    }
+
+    session( const session& ) = delete;
+    session& operator=( const session& ) = delete;
+
+    /** Whether the caller is the root process on its node */
+    bool is_root( ) const
+    {
+        return root_;
+    }
+
+    const hdeem_bmc_data_t& bmc_data( ) const
+    {
+        return data_;
+    }
+
+    const phdeem_info_t& info( ) const
+    {
+        return info_;
+    }
+
+    void start( )
+    {
+        phdeem_status_t status;
+        detail::check( phdeem_start( &data_, &info_, &status ), status, "phdeem_start" );
+    }
+
+    void stop( )
+    {
+        phdeem_status_t status;
+        detail::check( phdeem_stop( &data_, &info_, &status ), status, "phdeem_stop" );
+    }
+
+    void clear( )
+    {
+        phdeem_status_t status;
+        detail::check( phdeem_clear( &data_, &info_, &status ), status, "phdeem_clear" );
+    }
+
+    /** Calls phdeem_get_global() */
+    global_readings get_global( )
+    {
+        global_readings readings( *this );
+        phdeem_status_t status;
+        readings.valid_ = detail::check(
+            phdeem_get_global( &data_, &readings.read_, &info_, &status ), status,
+            "phdeem_get_global" );
+        return readings;
+    }
+
+private:
+    friend class global_readings;
+
+    hdeem_bmc_data_t data_;
+    phdeem_info_t info_;
+    bool root_;
+};
+
+inline global_readings::~global_readings( )
+{
+    if( valid_ )
+    {
+        phdeem_status_t status;
+        phdeem_data_free( &read_, &session_->info_, &status );
+    }
+}
+
+template <typename Kind>
+inline readings_view<Kind> global_readings::sensors( ) const
+{
+    // The bmc data is only filled in on root processes
+    return readings_view<Kind>( session_->data_, read_,
+                                valid_ ? sensor_traits<Kind>::nb_sensors( session_->data_ ) : 0 );
+}
+
+/**
+ * Closes the BMC connection kept open between sessions, see phdeem_disconnect().
+ */
+inline void disconnect( )
+{
+    phdeem_status_t status;
+    phdeem_disconnect( &status );
+}
+
+} // namespace phdeem
+
+#endif /* PHDEEM_HPP */
@@ -0,0 +1,113 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "phdeem_trace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Copies a name into a zero padded field of the given length, truncating it if necessary.
+ */
+static void _phdeem_trace_name( char* field, size_t len, const char* name )
+{
+    memset( field, 0, len );
+    if( name != NULL )
+    {
+        strncpy( field, name, len - 1 );
+    }
+}
+
+int phdeem_trace_write( const char* path, const char* node_name, uint32_t sampling_rate,
+                        uint32_t nb_sensors, const char* const* sensor_names,
+                        const phdeem_trace_region_t* regions, uint32_t nb_regions,
+                        uint64_t nb_values, phdeem_trace_sample_t sample, void* user_data )
+{
+    phdeem_trace_header_t header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, PHDEEM_TRACE_MAGIC, sizeof( header.magic ) );
+    header.version = PHDEEM_TRACE_VERSION;
+    header.nb_sensors = nb_sensors;
+    header.nb_values = nb_values;
+    header.sampling_rate = sampling_rate;
+    header.nb_regions = nb_regions;
+    _phdeem_trace_name( header.node_name, sizeof( header.node_name ), node_name );
+
+    float* values = malloc( ( nb_sensors > 0 ? nb_sensors : 1 ) * sizeof( float ) );
+    if( values == NULL )
+    {
+        return -1;
+    }
+
+    FILE* file = fopen( path, "wb" );
+    if( file == NULL )
+    {
+        free( values );
+        return -1;
+    }
+
+    int ok = fwrite( &header, sizeof( header ), 1, file ) == 1;
+
+    for( uint32_t i = 0; ok && i < nb_sensors; ++i )
+    {
+        char name[PHDEEM_TRACE_NAME_LEN];
+        _phdeem_trace_name( name, sizeof( name ), sensor_names[i] );
+        ok = fwrite( name, sizeof( name ), 1, file ) == 1;
+    }
+
+    if( ok && nb_regions > 0 )
+    {
+        ok = fwrite( regions, sizeof( *regions ), nb_regions, file ) == nb_regions;
+    }
+
+    for( uint64_t i = 0; ok && nb_sensors > 0 && i < nb_values; ++i )
+    {
+        sample( i, values, user_data );
+        ok = fwrite( values, sizeof( float ), nb_sensors, file ) == nb_sensors;
+    }
+
+    free( values );
+
+    // Don't let fclose() clobber the errno of a failed write
+    int error = errno;
+    if( fclose( file ) != 0 )
+    {
+        return -1;
+    }
+
+    if( !ok )
+    {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PHDEEM_TRACE_H
+#define PHDEEM_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * On-disk layout of a phdeem trace dump.
+ *
+ * A trace holds the blade readings of a single node. It is stored in the host byte order and
+ * consists of the following parts, written back to back without any padding:
+ *
+ * 1. A phdeem_trace_header_t.
+ * 2. nb_sensors sensor names, each PHDEEM_TRACE_NAME_LEN bytes long and zero padded.
+ * 3. nb_regions phdeem_trace_region_t entries.
+ * 4. nb_values * nb_sensors float values, sample by sample (i.e. all sensors of the first sample,
+ *    then all sensors of the second sample, ...).
+ *
+ * The first sensor is expected to be the power of the whole blade, as it is the case for the
+ * blade readings returned by hdeem_get_global().
+ */
+
+/** The magic bytes at the beginning of every trace, without terminating zero */
+#define PHDEEM_TRACE_MAGIC      "PHDEEMTR"
+/** The version of the trace format described in this header */
+#define PHDEEM_TRACE_VERSION    1
+/** The length of sensor and region names including the terminating zero */
+#define PHDEEM_TRACE_NAME_LEN   32
+
+/**
+ * The header at the beginning of every trace file.
+ */
+typedef struct phdeem_trace_header
+{
+    /** PHDEEM_TRACE_MAGIC */
+    char magic[8];
+    /** PHDEEM_TRACE_VERSION */
+    uint32_t version;
+    /** The number of sensors per sample */
+    uint32_t nb_sensors;
+    /** The number of samples */
+    uint64_t nb_values;
+    /** The sampling rate in samples per second */
+    uint32_t sampling_rate;
+    /** The number of regions following the sensor names */
+    uint32_t nb_regions;
+    /** The name of the node the trace was recorded on */
+    char node_name[2 * PHDEEM_TRACE_NAME_LEN];
+} phdeem_trace_header_t;
+
+/**
+ * A named range of samples, e.g. an application phase.
+ */
+typedef struct phdeem_trace_region
+{
+    /** The index of the first sample in the region */
+    uint64_t first_value;
+    /** The index of the first sample after the region */
+    uint64_t last_value;
+    /** The name of the region */
+    char name[PHDEEM_TRACE_NAME_LEN];
+} phdeem_trace_region_t;
+
+/**
+ * Provides the values of a single sample to phdeem_trace_write().
+ *
+ * @param index         The index of the sample.
+ * @param values        The buffer to store the nb_sensors values of the sample in.
+ * @param user_data     The user_data passed to phdeem_trace_write().
+ */
+typedef void ( *phdeem_trace_sample_t )( uint64_t index, float* values, void* user_data );
+
+/**
+ * Writes a trace file.
+ *
+ * This function doesn't depend on libhdeem or MPI, see phdeem_write_trace() for writing the
+ * readings returned by phdeem_get_global().
+ *
+ * @param path          The path of the file to write, an existing file is overwritten.
+ * @param node_name     The name of the node the trace was recorded on.
+ * @param sampling_rate The sampling rate in samples per second.
+ * @param nb_sensors    The number of sensors per sample.
+ * @param sensor_names  nb_sensors sensor names, longer names are truncated.
+ * @param regions       nb_regions regions, may be NULL if nb_regions is 0.
+ * @param nb_regions    The number of regions.
+ * @param nb_values     The number of samples.
+ * @param sample        Called for every sample in order to get its values.
+ * @param user_data     Passed to sample.
+ *
+ * @return              0 on success, -1 on errors with errno set accordingly.
+ */
+int phdeem_trace_write( const char* path, const char* node_name, uint32_t sampling_rate,
+                        uint32_t nb_sensors, const char* const* sensor_names,
+                        const phdeem_trace_region_t* regions, uint32_t nb_regions,
+                        uint64_t nb_values, phdeem_trace_sample_t sample, void* user_data );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PHDEEM_TRACE_H */
@@ -0,0 +1,87 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * hdeem.h isn't included on purpose: the fake doesn't look at any of the structs, so it doesn't
+ * need to know their layout, which differs between libhdeem versions.
+ */
+
+#include "fake_hdeem.h"
+
+int fake_hdeem_inits = 0;
+int fake_hdeem_closes = 0;
+
+int hdeem_init( void* hdeem_data )
+{
+    fake_hdeem_inits++;
+    return 0;
+}
+
+int hdeem_close( void* hdeem_data )
+{
+    fake_hdeem_closes++;
+    return 0;
+}
+
+int hdeem_start( void* hdeem_data )
+{
+    return 0;
+}
+
+int hdeem_stop( void* hdeem_data )
+{
+    return 0;
+}
+
+int hdeem_check_status( void* hdeem_data, void* hdeem_stats )
+{
+    return 0;
+}
+
+int hdeem_get_global( void* hdeem_data, void* hdeem_read )
+{
+    return 0;
+}
+
+int hdeem_get_stats( void* hdeem_data, void* hdeem_read )
+{
+    return 0;
+}
+
+void hdeem_data_free( void* hdeem_read )
+{
+}
+
+void hdeem_stats_free( void* hdeem_read )
+{
+}
+
+int hdeem_clear( void* hdeem_data )
+{
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "phdeem_trace.h"
+
+/**
+ * A power ramp starting at the given power of every sensor, rising by 1 W per sample.
+ */
+static void _sample( uint64_t index, float* values, void* user_data )
+{
+    const float* power = static_cast<const float*>( user_data );
+    values[0] = power[0] + index;
+    values[1] = power[1] + index;
+}
+
+static int _failures = 0;
+
+static void _expect( const std::string& output, const std::string& text )
+{
+    if( output.find( text ) == std::string::npos )
+    {
+        std::cerr << "Expected \"" << text << "\" in the output" << std::endl;
+        _failures++;
+    }
+}
+
+/**
+ * Runs phdeem-analyze on the files and returns its exit status, stderr is part of the output.
+ */
+static int _run( const std::string& tool, const std::vector<std::string>& files,
+                 std::string& output )
+{
+    std::string command = tool + " -j 2";
+    for( const auto& file : files )
+    {
+        command += " " + file;
+    }
+    command += " 2>&1";
+
+    FILE* pipe = popen( command.c_str( ), "r" );
+    if( pipe == nullptr )
+    {
+        std::perror( "popen" );
+        return -1;
+    }
+
+    char buffer[256];
+    while( fgets( buffer, sizeof( buffer ), pipe ) != nullptr )
+    {
+        output += buffer;
+    }
+    int status = pclose( pipe );
+    std::cout << output;
+
+    return status != -1 && WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+}
+
+int main( int argc, char** argv )
+{
+    if( argc != 2 )
+    {
+        std::cerr << "Usage: " << argv[0] << " phdeem-analyze" << std::endl;
+        return 1;
+    }
+
+    char dir[] = "/tmp/phdeem_test_XXXXXX";
+    if( mkdtemp( dir ) == nullptr )
+    {
+        std::perror( "mkdtemp" );
+        return 1;
+    }
+
+    const char* sensors[] = { "BLADE", "CPU0" };
+    float power_a[] = { 100.0f, 40.0f };
+    float power_b[] = { 200.0f, 80.0f };
+    phdeem_trace_region_t regions[2] = { { 0, 500, "init" }, { 500, 1000, "solve" } };
+    std::vector<std::string> files = { std::string( dir ) + "/a.phdeem",
+                                       std::string( dir ) + "/b.phdeem",
+                                       std::string( dir ) + "/empty.phdeem" };
+    std::vector<std::string> bad_files = { std::string( dir ) + "/truncated.phdeem",
+                                           std::string( dir ) + "/magic.phdeem",
+                                           std::string( dir ) + "/missing.phdeem" };
+
+    // 1 s from 100 W, 2 s from 200 W and an empty trace
+    if( phdeem_trace_write( files[0].c_str( ), "node_a", 1000, 2, sensors, regions, 2, 1000,
+                            _sample, power_a ) != 0 ||
+        phdeem_trace_write( files[1].c_str( ), "node_b", 1000, 2, sensors, regions, 1, 2000,
+                            _sample, power_b ) != 0 ||
+        phdeem_trace_write( files[2].c_str( ), "node_c", 1000, 2, sensors, nullptr, 0, 0,
+                            _sample, nullptr ) != 0 ||
+        phdeem_trace_write( bad_files[0].c_str( ), "node_d", 1000, 2, sensors, nullptr, 0, 1000,
+                            _sample, power_a ) != 0 ||
+        truncate( bad_files[0].c_str( ), 1000 ) != 0 )
+    {
+        std::perror( "phdeem_trace_write" );
+        return 1;
+    }
+    std::ofstream( bad_files[1] ) << std::string( 2 * sizeof( phdeem_trace_header_t ), 'x' );
+
+    std::string output;
+    if( _run( argv[1], files, output ) != 0 )
+    {
+        std::cerr << "phdeem-analyze failed" << std::endl;
+        _failures++;
+    }
+
+    // Blade power ramps from 100 to 1099 W on a and from 200 to 2199 W on b
+    _expect( output, "node_a                                  1.000        599.500     100.00    "
+                     "1099.00    599.00    999.00   1049.00   1089.00" );
+    _expect( output, "node_b                                  2.000       2399.000     200.00    "
+                     "2199.00   1199.00   1999.00   2099.00   2179.00" );
+    _expect( output, "node_c                                  0.000          0.000" );
+    _expect( output, "job: 3 nodes, 2.000 s, 2998.500 J" );
+    _expect( output, "init                                    2          1.000        399.500" );
+    _expect( output, "solve                                   1          0.500        424.750" );
+
+    std::string bad_output;
+    if( _run( argv[1], bad_files, bad_output ) != 1 )
+    {
+        std::cerr << "phdeem-analyze succeeded on broken traces" << std::endl;
+        _failures++;
+    }
+
+    _expect( bad_output, bad_files[0] + ": truncated trace" );
+    _expect( bad_output, bad_files[1] + ": not a phdeem trace or unsupported version" );
+    _expect( bad_output, bad_files[2] + ": cannot map file" );
+
+    for( const auto& file : files )
+    {
+        unlink( file.c_str( ) );
+    }
+    for( const auto& file : bad_files )
+    {
+        unlink( file.c_str( ) );
+    }
+    rmdir( dir );
+
+    return _failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fake_hdeem.h"
+#include "phdeem.h"
+
+/** The number of init/close cycles per test */
+#define NB_CYCLES               3
+
+static int _failures = 0;
+
+#define CHECK( expr ) _check( ( expr ), #expr, __LINE__ )
+
+static void _check( int ok, const char* expr, int line )
+{
+    if( !ok )
+    {
+        fprintf( stderr, "line %d: %s failed\n", line, expr );
+        _failures++;
+    }
+}
+
+static void _bmc_data( hdeem_bmc_data_t* data, char* host )
+{
+    memset( data, 0, sizeof( *data ) );
+    data->hasGPIO = 0;
+    data->host = host;
+    data->user = "user";
+    data->password = "password";
+}
+
+/**
+ * Runs init/close cycles and returns the number of hdeem_init() and hdeem_close() calls.
+ */
+static void _cycles( int* inits, int* closes )
+{
+    int init_before = fake_hdeem_inits;
+    int close_before = fake_hdeem_closes;
+    char host[] = "bmc";
+
+    for( int i = 0; i < NB_CYCLES; ++i )
+    {
+        hdeem_bmc_data_t data;
+        phdeem_info_t info;
+        phdeem_status_t status;
+
+        _bmc_data( &data, host );
+        CHECK( phdeem_init( &data, &info, MPI_COMM_SELF, &status ) == PHDEEM_SUCCESS );
+        CHECK( phdeem_close( &data, &info, &status ) == PHDEEM_SUCCESS );
+    }
+
+    *inits = fake_hdeem_inits - init_before;
+    *closes = fake_hdeem_closes - close_before;
+}
+
+/**
+ * The tests for PHDEEM_PERSISTENT_CONNECTION=0, run by a single process.
+ */
+static void _test_not_persistent( void )
+{
+    int inits, closes;
+    phdeem_status_t status;
+
+    // Every session sets up and closes its own connection
+    _cycles( &inits, &closes );
+    CHECK( inits == NB_CYCLES );
+    CHECK( closes == NB_CYCLES );
+
+    CHECK( phdeem_disconnect( &status ) == PHDEEM_NOT_ROOT );
+}
+
+/**
+ * The process local tests of the persistent connection, run by a single process.
+ */
+static void _test_persistent( void )
+{
+    int inits, closes;
+    hdeem_bmc_data_t data, other_data;
+    phdeem_info_t info, other_info;
+    phdeem_status_t status;
+    char host[] = "bmc";
+    char other_host[] = "other_bmc";
+
+    // Only the first session connects, the connection stays open
+    _cycles( &inits, &closes );
+    CHECK( inits == 1 );
+    CHECK( closes == 0 );
+
+    // Disconnecting during a session closes the connection when the session ends
+    _bmc_data( &data, host );
+    CHECK( phdeem_init( &data, &info, MPI_COMM_SELF, &status ) == PHDEEM_SUCCESS );
+    CHECK( phdeem_disconnect( &status ) == PHDEEM_SUCCESS );
+    CHECK( fake_hdeem_closes == 0 );
+    CHECK( phdeem_close( &data, &info, &status ) == PHDEEM_SUCCESS );
+    CHECK( fake_hdeem_closes == 1 );
+    CHECK( phdeem_disconnect( &status ) == PHDEEM_NOT_ROOT );
+    CHECK( fake_hdeem_closes == 1 );
+
+    // Other parameters can't share a connection in use
+    CHECK( phdeem_init( &data, &info, MPI_COMM_SELF, &status ) == PHDEEM_SUCCESS );
+    CHECK( fake_hdeem_inits == 2 );
+    _bmc_data( &other_data, other_host );
+    CHECK( phdeem_init( &other_data, &other_info, MPI_COMM_SELF, &status ) ==
+           PHDEEM_CONNECTION_ERROR );
+    CHECK( other_info.node_rank == -1 );
+    CHECK( phdeem_close( &other_data, &other_info, &status ) == PHDEEM_NOT_ROOT );
+    CHECK( fake_hdeem_inits == 2 );
+    CHECK( fake_hdeem_closes == 1 );
+
+    // But replace it once it's unused
+    CHECK( phdeem_close( &data, &info, &status ) == PHDEEM_SUCCESS );
+    CHECK( phdeem_init( &other_data, &other_info, MPI_COMM_SELF, &status ) == PHDEEM_SUCCESS );
+    CHECK( fake_hdeem_inits == 3 );
+    CHECK( fake_hdeem_closes == 2 );
+    CHECK( phdeem_close( &other_data, &other_info, &status ) == PHDEEM_SUCCESS );
+
+    CHECK( phdeem_disconnect( &status ) == PHDEEM_SUCCESS );
+    CHECK( fake_hdeem_closes == 3 );
+}
+
+/**
+ * Checks that the old root releases its connection if another process becomes node root.
+ *
+ * All processes have to run on the same node.
+ */
+static void _test_new_root( int rank )
+{
+    hdeem_bmc_data_t data;
+    phdeem_info_t info;
+    phdeem_status_t status;
+    MPI_Comm reversed;
+    char host[] = "bmc";
+
+    int init_before = fake_hdeem_inits;
+    int close_before = fake_hdeem_closes;
+
+    // Rank 0 is the node root and keeps the connection
+    _bmc_data( &data, host );
+    CHECK( phdeem_init( &data, &info, MPI_COMM_WORLD, &status ) ==
+           ( rank == 0 ? PHDEEM_SUCCESS : PHDEEM_NOT_ROOT ) );
+    phdeem_close( &data, &info, &status );
+
+    // On this communicator the last rank becomes node root
+    MPI_Comm_split( MPI_COMM_WORLD, 0, -rank, &reversed );
+    int is_root = phdeem_init( &data, &info, reversed, &status ) == PHDEEM_SUCCESS;
+    CHECK( is_root == ( info.node_rank == 0 ) );
+
+    if( rank == 0 )
+    {
+        CHECK( !is_root );
+        CHECK( fake_hdeem_inits - init_before == 1 );
+        CHECK( fake_hdeem_closes - close_before == 1 );
+    }
+    else if( is_root )
+    {
+        CHECK( fake_hdeem_inits - init_before == 1 );
+        CHECK( phdeem_close( &data, &info, &status ) == PHDEEM_SUCCESS );
+        CHECK( phdeem_disconnect( &status ) == PHDEEM_SUCCESS );
+    }
+
+    MPI_Comm_free( &reversed );
+}
+
+int main( int argc, char** argv )
+{
+    MPI_Init( &argc, &argv );
+
+    int rank, size;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    MPI_Comm_size( MPI_COMM_WORLD, &size );
+
+    const char* env = getenv( "PHDEEM_PERSISTENT_CONNECTION" );
+    int persistent = !( env != NULL && strcmp( env, "0" ) == 0 );
+
+    if( rank == 0 )
+    {
+        if( persistent )
+        {
+            _test_persistent( );
+        }
+        else
+        {
+            _test_not_persistent( );
+        }
+    }
+
+    MPI_Barrier( MPI_COMM_WORLD );
+
+    if( persistent && size > 1 )
+    {
+        _test_new_root( rank );
+    }
+
+    int failures = 0;
+    MPI_Allreduce( &_failures, &failures, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD );
+    if( rank == 0 )
+    {
+        printf( "%d failures.\n", failures );
+    }
+
+    MPI_Finalize( );
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phdeem.h"
+
+/** The largest number of processes the test supports */
+#define MAX_RANKS               64
+
+/** The number of blade and VR sensors of every fake node */
+static const unsigned long _nb_sensors[2] = { 3, 2 };
+
+static int _failures = 0;
+
+#define CHECK( expr ) _check( ( expr ), #expr, __LINE__ )
+
+static void _check( int ok, const char* expr, int line )
+{
+    if( !ok )
+    {
+        fprintf( stderr, "line %d: %s failed\n", line, expr );
+        _failures++;
+    }
+}
+
+/**
+ * The value of a sensor in the fake readings, exactly representable as float.
+ */
+static float _value( int rank, int is_vr, unsigned long index, unsigned long sensor )
+{
+    return rank * 100000.0f + is_vr * 50000.0f + index * 10.0f + sensor;
+}
+
+/**
+ * The number of samples of a fake node. Node 2 has no blade values, every third node no VR values.
+ */
+static unsigned long _nb_values( int rank, int is_vr )
+{
+    if( !is_vr )
+    {
+        return rank == 2 ? 0 : 50 + 7 * rank;
+    }
+
+    return rank % 3 == 0 ? 0 : 5 + rank;
+}
+
+/**
+ * Sets the values of a sample, whether libhdeem stores them behind a pointer or inline.
+ */
+static void _assign( hdeem_sensor_reading_t* sample, float* storage, unsigned long nb_sensors )
+{
+    if( __builtin_types_compatible_p( __typeof__( sample->value ), float* ) )
+    {
+        memcpy( &sample->value, &storage, sizeof( storage ) );
+    }
+    else
+    {
+        memcpy( &sample->value, storage, nb_sensors * sizeof( float ) );
+    }
+}
+
+/**
+ * Creates the fake readings of this process.
+ */
+static void _fill( int rank, hdeem_bmc_data_t* data, hdeem_global_reading_t* read,
+                   float* storage[2] )
+{
+    hdeem_sensor_reading_t* samples[2];
+
+    memset( data, 0, sizeof( *data ) );
+    memset( read, 0, sizeof( *read ) );
+    data->nb_blade_sensors = _nb_sensors[0];
+    data->nb_vr_sensors = _nb_sensors[1];
+    read->nb_blade_values = _nb_values( rank, 0 );
+    read->nb_vr_values = _nb_values( rank, 1 );
+
+    for( int is_vr = 0; is_vr < 2; ++is_vr )
+    {
+        unsigned long nb_values = _nb_values( rank, is_vr );
+        samples[is_vr] = calloc( nb_values + 1, sizeof( hdeem_sensor_reading_t ) );
+        storage[is_vr] = calloc( ( nb_values + 1 ) * _nb_sensors[is_vr], sizeof( float ) );
+
+        for( unsigned long i = 0; i < nb_values; ++i )
+        {
+            float* values = &storage[is_vr][i * _nb_sensors[is_vr]];
+            for( unsigned long s = 0; s < _nb_sensors[is_vr]; ++s )
+            {
+                values[s] = _value( rank, is_vr, i, s );
+            }
+            _assign( &samples[is_vr][i], values, _nb_sensors[is_vr] );
+        }
+    }
+
+    read->blade = samples[0];
+    read->vr = samples[1];
+}
+
+/**
+ * What the callback has seen so far.
+ */
+typedef struct received
+{
+    /** The number of values received per source and kind */
+    unsigned long nb_values[MAX_RANKS][2];
+    /** The first_value expected next per source and kind */
+    unsigned long next_value[MAX_RANKS][2];
+} received_t;
+
+static void _on_chunk( const phdeem_chunk_t* chunk, void* user_data )
+{
+    received_t* received = user_data;
+
+    CHECK( chunk->source >= 0 && chunk->source < MAX_RANKS );
+    CHECK( chunk->is_vr == 0 || chunk->is_vr == 1 );
+    if( chunk->source < 0 || chunk->source >= MAX_RANKS || ( chunk->is_vr & ~1 ) != 0 )
+    {
+        return;
+    }
+
+    // The chunks of a source arrive in order and without gaps
+    CHECK( chunk->first_value == received->next_value[chunk->source][chunk->is_vr] );
+    CHECK( chunk->nb_values > 0 );
+    CHECK( chunk->first_value + chunk->nb_values <= chunk->total_values );
+    CHECK( chunk->total_values == _nb_values( chunk->source, chunk->is_vr ) );
+    CHECK( chunk->nb_sensors == _nb_sensors[chunk->is_vr] );
+
+    for( unsigned long i = 0; i < chunk->nb_values; ++i )
+    {
+        for( unsigned long s = 0; s < chunk->nb_sensors; ++s )
+        {
+            float expected = _value( chunk->source, chunk->is_vr, chunk->first_value + i, s );
+            if( chunk->values[i * chunk->nb_sensors + s] != expected )
+            {
+                fprintf( stderr, "source %d, kind %d, value %lu, sensor %lu: %f != %f\n",
+                         chunk->source, chunk->is_vr, chunk->first_value + i, s,
+                         chunk->values[i * chunk->nb_sensors + s], expected );
+                _failures++;
+            }
+        }
+    }
+
+    received->next_value[chunk->source][chunk->is_vr] += chunk->nb_values;
+    received->nb_values[chunk->source][chunk->is_vr] += chunk->nb_values;
+}
+
+/**
+ * Gathers with the given node roots and checks what the collector received.
+ *
+ * @param roots     Whether each rank is a node root.
+ */
+static void _test_gather( int rank, int size, const int* roots, int collector,
+                          unsigned long chunk_values, hdeem_bmc_data_t* data,
+                          hdeem_global_reading_t* read )
+{
+    phdeem_info_t info;
+    phdeem_status_t status;
+    received_t received;
+
+    memset( &info, 0, sizeof( info ) );
+    memset( &received, 0, sizeof( received ) );
+    info.node_rank = roots[rank] ? 0 : 1;
+
+    int ret = phdeem_gather_global( data, read, &info, MPI_COMM_WORLD, collector, chunk_values,
+                                    _on_chunk, &received, &status );
+
+    CHECK( ret == ( roots[rank] || rank == collector ? PHDEEM_SUCCESS : PHDEEM_NOT_ROOT ) );
+    CHECK( status.mpi_ret_value == MPI_SUCCESS );
+
+    if( rank != collector )
+    {
+        return;
+    }
+
+    for( int source = 0; source < size; ++source )
+    {
+        for( int is_vr = 0; is_vr < 2; ++is_vr )
+        {
+            unsigned long expected = roots[source] ? _nb_values( source, is_vr ) : 0;
+            if( received.nb_values[source][is_vr] != expected )
+            {
+                fprintf( stderr, "source %d, kind %d: %lu values received, %lu expected\n",
+                         source, is_vr, received.nb_values[source][is_vr], expected );
+                _failures++;
+            }
+        }
+    }
+}
+
+/**
+ * Checks that an invalid chunk size is rejected everywhere.
+ */
+static void _test_invalid( unsigned long chunk_values, int is_root, hdeem_bmc_data_t* data,
+                           hdeem_global_reading_t* read )
+{
+    phdeem_info_t info;
+    phdeem_status_t status;
+    received_t received;
+
+    memset( &info, 0, sizeof( info ) );
+    memset( &received, 0, sizeof( received ) );
+    info.node_rank = is_root ? 0 : 1;
+
+    int ret = phdeem_gather_global( data, read, &info, MPI_COMM_WORLD, 0, chunk_values,
+                                    _on_chunk, &received, &status );
+
+    CHECK( ret == PHDEEM_MPI_ERROR );
+    CHECK( status.mpi_ret_value == MPI_ERR_COUNT );
+}
+
+int main( int argc, char** argv )
+{
+    MPI_Init( &argc, &argv );
+
+    int rank, size;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    MPI_Comm_size( MPI_COMM_WORLD, &size );
+
+    // More node roots than the collector serves at once, a non-root process and the collector
+    if( size < PHDEEM_GATHER_SENDERS + 3 || size > MAX_RANKS )
+    {
+        if( rank == 0 )
+        {
+            fprintf( stderr, "Run with %d to %d processes.\n", PHDEEM_GATHER_SENDERS + 3,
+                     MAX_RANKS );
+        }
+        MPI_Finalize( );
+        return 1;
+    }
+
+    hdeem_bmc_data_t data;
+    hdeem_global_reading_t read;
+    float* storage[2];
+    int roots[MAX_RANKS];
+
+    _fill( rank, &data, &read, storage );
+
+    // Everybody is a node root, including the collector
+    for( int i = 0; i < size; ++i )
+    {
+        roots[i] = 1;
+    }
+    _test_gather( rank, size, roots, 0, 7, &data, &read );
+
+    // The collector and another process aren't node roots, chunks larger than all readings
+    roots[1] = 0;
+    roots[3] = 0;
+    _test_gather( rank, size, roots, 1, 7, &data, &read );
+    _test_gather( rank, size, roots, 1, 1000, &data, &read );
+
+    // A single sample per chunk
+    _test_gather( rank, size, roots, size - 1, 1, &data, &read );
+
+    _test_invalid( 0, roots[rank], &data, &read );
+    _test_invalid( ULONG_MAX / 2, roots[rank], &data, &read );
+
+    free( storage[0] );
+    free( storage[1] );
+    free( read.blade );
+    free( read.vr );
+
+    int failures = 0;
+    MPI_Allreduce( &_failures, &failures, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD );
+    if( rank == 0 )
+    {
+        printf( "%d failures.\n", failures );
+    }
+
+    MPI_Finalize( );
+
+    return failures == 0 ? 0 : 1;
+}
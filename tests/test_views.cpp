@@ -0,0 +1,185 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "phdeem.hpp"
+
+static int _failures = 0;
+
+static void _check( bool ok, const char* expr, int line )
+{
+    if( !ok )
+    {
+        std::cerr << "line " << line << ": " << expr << " failed" << std::endl;
+        _failures++;
+    }
+}
+
+#define CHECK( expr ) _check( ( expr ), #expr, __LINE__ )
+
+/**
+ * Sets the values of a sample, whether libhdeem stores them behind a pointer ...
+ *
+ * Only one of the overloads is used, so they must not be plain static functions.
+ */
+inline void _assign( float*& value, float* storage, std::size_t )
+{
+    value = storage;
+}
+
+/**
+ * ... or inline.
+ */
+template <std::size_t N>
+inline void _assign( float ( &value )[N], float* storage, std::size_t nb_sensors )
+{
+    std::copy( storage, storage + nb_sensors, value );
+}
+
+/**
+ * Fills samples with nb_values samples of nb_sensors values, ( sensor + 1 ) * shape[sample] each.
+ */
+static void _fill( std::vector<hdeem_sensor_reading_t>& samples, std::vector<float>& storage,
+                   std::size_t nb_values, std::size_t nb_sensors, const float* shape )
+{
+    samples.resize( nb_values );
+    storage.resize( nb_values * nb_sensors );
+    for( std::size_t i = 0; i < nb_values; ++i )
+    {
+        for( std::size_t s = 0; s < nb_sensors; ++s )
+        {
+            storage[i * nb_sensors + s] = ( s + 1 ) * shape[i];
+        }
+        _assign( samples[i].value, &storage[i * nb_sensors], nb_sensors );
+    }
+}
+
+template <typename Kind>
+static void _check_views( const hdeem_bmc_data_t& data, const hdeem_global_reading_t& read,
+                          std::size_t nb_sensors, std::size_t nb_values, const float* shape,
+                          std::size_t max_index )
+{
+    phdeem::readings_view<Kind> sensors( data, read, nb_sensors );
+    CHECK( sensors.size( ) == nb_sensors );
+
+    for( std::size_t s = 0; s < sensors.size( ); ++s )
+    {
+        phdeem::sensor_view<Kind> sensor = sensors[s];
+        CHECK( sensor.size( ) == nb_values );
+        CHECK( !sensor.empty( ) );
+        CHECK( std::distance( sensor.begin( ), sensor.end( ) ) ==
+               static_cast<std::ptrdiff_t>( nb_values ) );
+
+        for( std::size_t i = 0; i < nb_values; ++i )
+        {
+            CHECK( sensor[i] == ( s + 1 ) * shape[i] );
+            CHECK( sensor.begin( )[i] == sensor[i] );
+            CHECK( *( sensor.begin( ) + i ) == sensor[i] );
+        }
+
+        auto max = std::max_element( sensor.begin( ), sensor.end( ) );
+        CHECK( max - sensor.begin( ) == static_cast<std::ptrdiff_t>( max_index ) );
+        CHECK( *max == ( s + 1 ) * shape[max_index] );
+
+        auto last = sensor.end( );
+        --last;
+        CHECK( *last == sensor[nb_values - 1] );
+        CHECK( sensor.begin( ) < last && last < sensor.end( ) );
+    }
+}
+
+template <typename Kind>
+static void _check_empty( const hdeem_bmc_data_t& data )
+{
+    // What non-root processes get: nothing read and no sensors
+    hdeem_global_reading_t read = hdeem_global_reading_t( );
+    phdeem::readings_view<Kind> sensors( data, read, 0 );
+    CHECK( sensors.size( ) == 0 );
+
+    phdeem::sensor_view<Kind> sensor( data, read, 0 );
+    CHECK( sensor.empty( ) );
+    CHECK( sensor.size( ) == 0 );
+    CHECK( sensor.begin( ) == sensor.end( ) );
+    CHECK( std::distance( sensor.begin( ), sensor.end( ) ) == 0 );
+    CHECK( std::max_element( sensor.begin( ), sensor.end( ) ) == sensor.end( ) );
+}
+
+int main( void )
+{
+    const float blade_shape[] = { 3.0f, 7.0f, 5.0f, 1.0f };
+    const float vr_shape[] = { 2.0f, 4.0f, 9.0f };
+
+    char blade_0[] = "BLADE";
+    char blade_1[] = "CPU0";
+    char vr_0[] = "VR0";
+    char* blade_names[] = { blade_0, blade_1 };
+    char* vr_names[] = { vr_0 };
+
+    hdeem_bmc_data_t data = hdeem_bmc_data_t( );
+    data.nb_blade_sensors = 2;
+    data.nb_vr_sensors = 1;
+    data.name_blade_sensors = blade_names;
+    data.name_vr_sensors = vr_names;
+
+    std::vector<hdeem_sensor_reading_t> blade_samples, vr_samples;
+    std::vector<float> blade_storage, vr_storage;
+    _fill( blade_samples, blade_storage, 4, 2, blade_shape );
+    _fill( vr_samples, vr_storage, 3, 1, vr_shape );
+
+    hdeem_global_reading_t read = hdeem_global_reading_t( );
+    read.nb_blade_values = 4;
+    read.nb_vr_values = 3;
+    read.blade = blade_samples.data( );
+    read.vr = vr_samples.data( );
+
+    _check_views<phdeem::blade>( data, read, 2, 4, blade_shape, 1 );
+    _check_views<phdeem::vr>( data, read, 1, 3, vr_shape, 2 );
+
+    CHECK( std::string( phdeem::readings_view<phdeem::blade>( data, read, 2 )[1].name( ) ) ==
+           "CPU0" );
+    CHECK( std::string( phdeem::readings_view<phdeem::vr>( data, read, 1 )[0].name( ) ) == "VR0" );
+
+    // The views must not copy, but read the library's buffers
+    blade_samples[2].value[1] = 100.0f;
+    CHECK( ( phdeem::readings_view<phdeem::blade>( data, read, 2 )[1][2] == 100.0f ) );
+
+    _check_empty<phdeem::blade>( data );
+    _check_empty<phdeem::vr>( data );
+
+    if( _failures == 0 )
+    {
+        std::cout << "All checks passed." << std::endl;
+    }
+
+    return _failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,475 @@
+/**
+  Copyright (c) 2016, Technische Universität Dresden, Germany
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted
+  provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this list of conditions
+     and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice, this list of
+     conditions and the following disclaimer in the documentation and/or other materials provided
+     with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors may be used to
+     endorse or promote products derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "phdeem_trace.h"
+
+
+/** The power percentiles reported for every node */
+static const double _percentiles[] = { 0.5, 0.9, 0.95, 0.99 };
+static const std::size_t _nb_percentiles = sizeof( _percentiles ) / sizeof( _percentiles[0] );
+
+/**
+ * Summary of a region within a single trace.
+ */
+struct region_result
+{
+    std::string name;
+    double duration;
+    double energy;
+};
+
+/**
+ * Summary of a single trace, i.e. a single node.
+ */
+struct node_result
+{
+    std::string file;
+    std::string node_name;
+    std::string error;
+    double duration;
+    double energy;
+    float min_power;
+    float max_power;
+    float percentiles[_nb_percentiles];
+    std::vector<region_result> regions;
+};
+
+/**
+ * A read only memory mapping of a whole file.
+ */
+class mapped_file
+{
+public:
+    explicit mapped_file( const std::string& path ) : data_( nullptr ), size_( 0 )
+    {
+        int fd = open( path.c_str( ), O_RDONLY );
+        if( fd < 0 )
+        {
+            return;
+        }
+
+        struct stat st;
+        if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+        {
+            void* data = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if( data != MAP_FAILED )
+            {
+                // The samples are read front to back exactly once
+                madvise( data, st.st_size, MADV_SEQUENTIAL );
+                data_ = static_cast<const char*>( data );
+                size_ = st.st_size;
+            }
+        }
+
+        // The mapping stays valid after closing the descriptor
+        close( fd );
+    }
+
+    ~mapped_file( )
+    {
+        if( data_ != nullptr )
+        {
+            munmap( const_cast<char*>( data_ ), size_ );
+        }
+    }
+
+    mapped_file( const mapped_file& ) = delete;
+    mapped_file& operator=( const mapped_file& ) = delete;
+
+    const char* data( ) const
+    {
+        return data_;
+    }
+
+    std::size_t size( ) const
+    {
+        return size_;
+    }
+
+private:
+    const char* data_;
+    std::size_t size_;
+};
+
+/**
+ * Runs a fixed set of tasks on a number of threads.
+ *
+ * Every worker owns a deque of task indices, which is seeded round robin before the workers are
+ * started. A worker takes tasks from the front of its own deque and, once that is empty, steals
+ * from the back of the other workers' deques. Traces may differ a lot in length, so this keeps all
+ * workers busy until the very end without a central queue every worker contends on.
+ */
+class work_stealing_pool
+{
+public:
+    explicit work_stealing_pool( std::size_t nb_workers ) : queues_( nb_workers )
+    {
+    }
+
+    template <typename Task>
+    void run( std::size_t nb_tasks, Task task )
+    {
+        for( std::size_t i = 0; i < nb_tasks; ++i )
+        {
+            queues_[i % queues_.size( )].tasks.push_back( i );
+        }
+
+        std::vector<std::thread> workers;
+        for( std::size_t id = 0; id < queues_.size( ); ++id )
+        {
+            workers.emplace_back( [this, id, &task]( )
+            {
+                std::size_t index;
+                while( next( id, index ) )
+                {
+                    task( index );
+                }
+            } );
+        }
+
+        for( auto& worker : workers )
+        {
+            worker.join( );
+        }
+    }
+
+private:
+    struct queue
+    {
+        std::mutex lock;
+        std::deque<std::size_t> tasks;
+    };
+
+    bool next( std::size_t id, std::size_t& index )
+    {
+        // Own work first, oldest task first
+        {
+            std::lock_guard<std::mutex> guard( queues_[id].lock );
+            if( !queues_[id].tasks.empty( ) )
+            {
+                index = queues_[id].tasks.front( );
+                queues_[id].tasks.pop_front( );
+                return true;
+            }
+        }
+
+        // Steal from the others, newest task first. No new tasks are added while running, so
+        // finding every queue empty once means we're done.
+        for( std::size_t i = 1; i < queues_.size( ); ++i )
+        {
+            queue& victim = queues_[( id + i ) % queues_.size( )];
+            std::lock_guard<std::mutex> guard( victim.lock );
+            if( !victim.tasks.empty( ) )
+            {
+                index = victim.tasks.back( );
+                victim.tasks.pop_back( );
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::vector<queue> queues_;
+};
+
+/**
+ * Returns the given percentile of the values, reordering them.
+ */
+static float _percentile( std::vector<float>& values, double percentile )
+{
+    auto nth = values.begin( ) + static_cast<std::size_t>( percentile * ( values.size( ) - 1 ) );
+    std::nth_element( values.begin( ), nth, values.end( ) );
+    return *nth;
+}
+
+/**
+ * Returns a std::string from a possibly not zero terminated name field.
+ */
+static std::string _name( const char* name, std::size_t len )
+{
+    return std::string( name, strnlen( name, len ) );
+}
+
+/**
+ * Analyzes a single trace.
+ *
+ * @param path      The path of the trace file.
+ * @param result    The node_result the summary is stored in.
+ * @param power     Scratch space for the percentile computation, reused between calls.
+ */
+static void _analyze( const std::string& path, node_result& result, std::vector<float>& power )
+{
+    result.file = path;
+
+    mapped_file file( path );
+    if( file.data( ) == nullptr )
+    {
+        result.error = "cannot map file";
+        return;
+    }
+
+    if( file.size( ) < sizeof( phdeem_trace_header_t ) )
+    {
+        result.error = "truncated header";
+        return;
+    }
+
+    phdeem_trace_header_t header;
+    memcpy( &header, file.data( ), sizeof( header ) );
+    if( memcmp( header.magic, PHDEEM_TRACE_MAGIC, sizeof( header.magic ) ) != 0 ||
+        header.version != PHDEEM_TRACE_VERSION )
+    {
+        result.error = "not a phdeem trace or unsupported version";
+        return;
+    }
+
+    if( header.nb_sensors == 0 || header.sampling_rate == 0 )
+    {
+        result.error = "no sensors or no sampling rate";
+        return;
+    }
+
+    std::size_t names_offset = sizeof( header );
+    std::size_t regions_offset = names_offset +
+                                 std::size_t( header.nb_sensors ) * PHDEEM_TRACE_NAME_LEN;
+    std::size_t values_offset = regions_offset +
+                                std::size_t( header.nb_regions ) * sizeof( phdeem_trace_region_t );
+    if( file.size( ) < values_offset ||
+        ( file.size( ) - values_offset ) / ( header.nb_sensors * sizeof( float ) ) <
+            header.nb_values )
+    {
+        result.error = "truncated trace";
+        return;
+    }
+
+    result.node_name = _name( header.node_name, sizeof( header.node_name ) );
+
+    // Only the blade power (the first sensor) is needed, so walk it with a stride
+    const float* values = reinterpret_cast<const float*>( file.data( ) + values_offset );
+    const std::size_t stride = header.nb_sensors;
+    const double period = 1.0 / header.sampling_rate;
+
+    power.resize( header.nb_values );
+    double sum = 0.0;
+    for( std::size_t i = 0; i < header.nb_values; ++i )
+    {
+        power[i] = values[i * stride];
+        sum += power[i];
+    }
+
+    result.duration = header.nb_values * period;
+    result.energy = sum * period;
+
+    for( std::size_t i = 0; i < header.nb_regions; ++i )
+    {
+        phdeem_trace_region_t region;
+        memcpy( &region, file.data( ) + regions_offset + i * sizeof( region ), sizeof( region ) );
+
+        uint64_t last = std::min<uint64_t>( region.last_value, header.nb_values );
+        uint64_t first = std::min<uint64_t>( region.first_value, last );
+
+        double region_sum = 0.0;
+        for( uint64_t j = first; j < last; ++j )
+        {
+            region_sum += power[j];
+        }
+
+        result.regions.push_back( { _name( region.name, sizeof( region.name ) ),
+                                    ( last - first ) * period, region_sum * period } );
+    }
+
+    if( power.empty( ) )
+    {
+        result.min_power = result.max_power = 0.0f;
+        std::fill( result.percentiles, result.percentiles + _nb_percentiles, 0.0f );
+        return;
+    }
+
+    // The regions are done, so the power values may be reordered from here on
+    auto minmax = std::minmax_element( power.begin( ), power.end( ) );
+    result.min_power = *minmax.first;
+    result.max_power = *minmax.second;
+    for( std::size_t i = 0; i < _nb_percentiles; ++i )
+    {
+        result.percentiles[i] = _percentile( power, _percentiles[i] );
+    }
+}
+
+static void _usage( const char* name )
+{
+    std::cerr << "Usage: " << name << " [-j threads] trace..." << std::endl;
+}
+
+int main( int argc, char** argv )
+{
+    std::size_t nb_threads = std::max( 1u, std::thread::hardware_concurrency( ) );
+    std::vector<std::string> files;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        if( strcmp( argv[i], "-j" ) == 0 && i + 1 < argc )
+        {
+            nb_threads = std::max( 1l, strtol( argv[++i], nullptr, 10 ) );
+        }
+        else if( argv[i][0] == '-' )
+        {
+            _usage( argv[0] );
+            return 1;
+        }
+        else
+        {
+            files.push_back( argv[i] );
+        }
+    }
+
+    if( files.empty( ) )
+    {
+        _usage( argv[0] );
+        return 1;
+    }
+
+    nb_threads = std::min( nb_threads, files.size( ) );
+
+    // Every task writes its own slot only, so no locking is needed for the results
+    std::vector<node_result> results( files.size( ) );
+    work_stealing_pool pool( nb_threads );
+    pool.run( files.size( ), [&]( std::size_t index )
+    {
+        thread_local std::vector<float> power;
+        _analyze( files[index], results[index], power );
+    } );
+
+    // Reduce in input order, so the output doesn't depend on the scheduling
+    struct region_summary
+    {
+        std::size_t count;
+        double duration;
+        double energy;
+    };
+    std::map<std::string, region_summary> regions;
+    std::vector<double> node_power;
+    std::size_t nb_nodes = 0;
+    double job_energy = 0.0;
+    double job_duration = 0.0;
+    int ret = 0;
+
+    printf( "%-32s %12s %14s %10s %10s", "node", "duration [s]", "energy [J]", "min [W]",
+            "max [W]" );
+    for( std::size_t i = 0; i < _nb_percentiles; ++i )
+    {
+        char label[32];
+        snprintf( label, sizeof( label ), "p%g [W]", _percentiles[i] * 100 );
+        printf( " %9s", label );
+    }
+    printf( "\n" );
+
+    for( const auto& result : results )
+    {
+        if( !result.error.empty( ) )
+        {
+            fprintf( stderr, "%s: %s\n", result.file.c_str( ), result.error.c_str( ) );
+            ret = 1;
+            continue;
+        }
+
+        printf( "%-32s %12.3f %14.3f %10.2f %10.2f",
+                result.node_name.empty( ) ? result.file.c_str( ) : result.node_name.c_str( ),
+                result.duration, result.energy, result.min_power, result.max_power );
+        for( std::size_t i = 0; i < _nb_percentiles; ++i )
+        {
+            printf( " %9.2f", result.percentiles[i] );
+        }
+        printf( "\n" );
+
+        nb_nodes++;
+        job_energy += result.energy;
+        job_duration = std::max( job_duration, result.duration );
+        if( result.duration > 0.0 )
+        {
+            node_power.push_back( result.energy / result.duration );
+        }
+
+        for( const auto& region : result.regions )
+        {
+            region_summary& summary = regions[region.name];
+            summary.count++;
+            summary.duration += region.duration;
+            summary.energy += region.energy;
+        }
+    }
+
+    // Empty traces count as nodes, but have no average power
+    printf( "\njob: %zu nodes, %.3f s, %.3f J\n", nb_nodes, job_duration, job_energy );
+
+    if( !node_power.empty( ) )
+    {
+        std::sort( node_power.begin( ), node_power.end( ) );
+        printf( "average node power [W]: min %.2f", node_power.front( ) );
+        for( std::size_t i = 0; i < _nb_percentiles; ++i )
+        {
+            printf( ", p%g %.2f", _percentiles[i] * 100,
+                    node_power[static_cast<std::size_t>( _percentiles[i] *
+                                                         ( node_power.size( ) - 1 ) )] );
+        }
+        printf( ", max %.2f\n", node_power.back( ) );
+    }
+
+    if( !regions.empty( ) )
+    {
+        printf( "\n%-32s %8s %14s %14s %12s\n", "region", "count", "duration [s]", "energy [J]",
+                "power [W]" );
+        for( const auto& region : regions )
+        {
+            printf( "%-32s %8zu %14.3f %14.3f %12.2f\n", region.first.c_str( ),
+                    region.second.count, region.second.duration, region.second.energy,
+                    region.second.duration > 0.0 ?
+                        region.second.energy / region.second.duration : 0.0 );
+        }
+    }
+
+    return ret;
+}